@@ -34,10 +34,15 @@
 #include "launcherplaceslist.h"
 #include "iconimageprovider.h"
 #include "blendedimageprovider.h"
+#include "blurredbackgroundimageprovider.h"
 #include "qsortfilterproxymodelqml.h"
 #include "windowimageprovider.h"
+#include "windowthumbnailitem.h"
+#include "windowthumbnailregistry.h"
 #include "windowinfo.h"
 #include "windowslist.h"
+#include "filteredwindowslist.h"
+#include "spreadlayout.h"
 #include "screeninfo.h"
 #include "plugin.h"
 #include "cacheeffect.h"
@@ -101,6 +106,9 @@ void Unity2dPlugin::registerTypes(const char *uri)
 
     qmlRegisterType<WindowInfo>(uri, 0, 1, "WindowInfo");
     qmlRegisterType<WindowsList>(uri, 0, 1, "WindowsList");
+    qmlRegisterType<FilteredWindowsList>(uri, 0, 1, "FilteredWindowsList");
+    qmlRegisterType<SpreadLayout>(uri, 0, 1, "SpreadLayout");
+    qmlRegisterType<DeclarativeWindowThumbnail>(uri, 0, 1, "WindowThumbnail");
     qmlRegisterType<ScreenInfo>(); // Register the type as non creatable
     qmlRegisterType<WorkspacesInfo>(); // Register the type as non creatable
 
@@ -171,11 +179,15 @@ void Unity2dPlugin::initializeEngine(QDeclarativeEngine *engine, const char *uri
     engine->addImageProvider(QString("blended"), new BlendedImageProvider(engine->baseUrl()));
     engine->addImageProvider(QString("window"), new WindowImageProvider);
     engine->addImageProvider(QString("icons"), new IconImageProvider);
+    engine->addImageProvider(QString("blurredbackground"), new BlurredBackgroundImageProvider);
 
     /* ScreenInfo is exposed as a context property as it's a singleton and therefore
        not creatable directly in QML */
     engine->rootContext()->setContextProperty("screen", ScreenInfo::instance());
     engine->rootContext()->setContextProperty("iconUtilities", new IconUtilities(engine));
+    /* Exposes statistics on the window images shared by WindowThumbnail items.
+       The registry sets nothing up until a window is first acquired. */
+    engine->rootContext()->setContextProperty("windowThumbnails", WindowThumbnailRegistry::instance());
 
     /* Critically important to set the client type to pager because wnck
        will pass that type over to the window manager through XEvents.
@@ -15,39 +15,110 @@
  */
 
 #include "blendedimageprovider.h"
+#include <QMutexLocker>
 #include <QPainter>
 #include <debug_p.h>
 
-BlendedImageProvider::BlendedImageProvider(QUrl baseUrl) : QDeclarativeImageProvider(QDeclarativeImageProvider::Image),
-                                                           m_baseUrl(baseUrl)
+static const int DEFAULT_MEMORY_BUDGET = 4 * 1024 * 1024;
+/* Part of the budget used by the images as loaded from disk and scaled */
+static const int BASE_IMAGES_BUDGET_RATIO = 2;
+
+static const char COLOR_TAG[] = "color=";
+static const int COLOR_TAG_LENGTH = sizeof(COLOR_TAG) - 1;
+static const char ALPHA_TAG[] = "alpha=";
+static const int ALPHA_TAG_LENGTH = sizeof(ALPHA_TAG) - 1;
+
+static QString cacheKey(const QString& fileName, const QSize& size)
+{
+    return QString("%1\n%2x%3").arg(fileName).arg(size.width()).arg(size.height());
+}
+
+static int imageCost(const QImage& image)
 {
+    return qMax(1, image.byteCount());
+}
+
+/* Whether string is of the form \d+(\.\d+)? */
+static bool isDecimal(const QStringRef& string)
+{
+    int dot = -1;
+    for (int i = 0; i < string.length(); ++i) {
+        QChar c = string.at(i);
+        if (c == '.' && dot == -1) {
+            dot = i;
+        } else if (!c.isDigit()) {
+            return false;
+        }
+    }
+    return dot != 0 && dot != string.length() - 1 && !string.isEmpty();
+}
+
+BlendedImageProvider::BlendedImageProvider(QUrl baseUrl) : QDeclarativeImageProvider(QDeclarativeImageProvider::Image)
+    , m_baseUrl(baseUrl)
+    , m_hitCount(0)
+    , m_missCount(0)
+{
+    setMemoryBudget(DEFAULT_MEMORY_BUDGET);
 }
 
 BlendedImageProvider::~BlendedImageProvider()
 {
 }
 
-QImage BlendedImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+void BlendedImageProvider::setMemoryBudget(int bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    int baseImagesBudget = bytes / BASE_IMAGES_BUDGET_RATIO;
+    m_baseImages.setMaxCost(baseImagesBudget);
+    m_blendedImages.setMaxCost(bytes - baseImagesBudget);
+}
+
+int BlendedImageProvider::memoryBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_baseImages.maxCost() + m_blendedImages.maxCost();
+}
+
+int BlendedImageProvider::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_baseImages.totalCost() + m_blendedImages.totalCost();
+}
+
+int BlendedImageProvider::hitCount() const
 {
-    /* id is of the form [FILENAME]color=[COLORNAME]alpha=[FLOAT] */
-    QRegExp rx("^(.+)color=(.+)alpha=(\\d+(?:\\.\\d+)?)$");
-    if (rx.indexIn(id)) {
+    QMutexLocker locker(&m_mutex);
+    return m_hitCount;
+}
+
+int BlendedImageProvider::missCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_missCount;
+}
+
+bool BlendedImageProvider::parseId(const QString &id, QString *fileName, QColor *color)
+{
+    /* Same matching as ^(.+)color=(.+)alpha=(\d+(?:\.\d+)?)$ would do: the
+       alpha is after the last "alpha=" and the color after the last
+       "color=" before it, both being non empty, as is the file name. */
+    int alphaIndex = id.lastIndexOf(QLatin1String(ALPHA_TAG));
+    int colorIndex = (alphaIndex > COLOR_TAG_LENGTH) ?
+                     id.lastIndexOf(QLatin1String(COLOR_TAG), alphaIndex - COLOR_TAG_LENGTH - 1) : -1;
+    QStringRef alphaString = id.midRef(alphaIndex + ALPHA_TAG_LENGTH);
+    if (colorIndex == -1 || !isDecimal(alphaString)) {
         UQ_WARNING << "BlendedImageProvider: failed to match id:" << id;
-        return QImage();
+        return false;
     }
-    QStringList list = rx.capturedTexts();
 
-    QString fileName = list[1];
-    if (fileName.isEmpty()) {
+    if (colorIndex == 0) {
         UQ_WARNING << "BlendedImageProvider: filename can't be empty.";
-        return QImage();
+        return false;
     }
+    *fileName = id.left(colorIndex);
 
-    /* Merge baseUrl with fileName. If fileName is an absolute path, the result
-       will be fileName itself. */
-    fileName = m_baseUrl.resolved(QUrl::fromLocalFile(fileName)).toLocalFile();
-
-    QString colorName = list[2];
+    int colorStart = colorIndex + COLOR_TAG_LENGTH;
+    QString colorName = id.mid(colorStart, alphaIndex - colorStart);
     if (!QColor::isValidColor(colorName)) {
         /* Passing a named color of the form #RRGGBB is impossible
            due to the fact that QML Image considers the source an URL and strips any anchor
@@ -58,19 +129,32 @@ QImage BlendedImageProvider::requestImage(const QString &id, QSize *size, const
         */
         colorName.prepend("#");
         if (!QColor::isValidColor(colorName)) {
-            UQ_WARNING << "BlendedImageProvider: invalid color name:" << list[2];
-            return QImage();
+            UQ_WARNING << "BlendedImageProvider: invalid color name:" << colorName.mid(1);
+            return false;
         }
     }
-    QColor color(colorName);
+    color->setNamedColor(colorName);
 
     bool valid = false;
-    float alpha = list[3].toFloat(&valid);
+    float alpha = alphaString.toString().toFloat(&valid);
     if (!valid) {
-        UQ_WARNING << "BlendedImageProvider: can't convert alpha to floating point:" << list[3];
-        return QImage();
+        UQ_WARNING << "BlendedImageProvider: can't convert alpha to floating point:" << alphaString.toString();
+        return false;
+    }
+    color->setAlphaF(alpha);
+    return true;
+}
+
+QImage BlendedImageProvider::loadImage(const QString &fileName, const QSize &requestedSize)
+{
+    QString key = cacheKey(fileName, requestedSize);
+    {
+        QMutexLocker locker(&m_mutex);
+        QImage* cached = m_baseImages.object(key);
+        if (cached != NULL) {
+            return *cached;
+        }
     }
-    color.setAlphaF(alpha);
 
     QImage image(fileName);
     if (image.isNull()) {
@@ -86,6 +170,45 @@ QImage BlendedImageProvider::requestImage(const QString &id, QSize *size, const
         image = image.scaled(requestedSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
     }
 
+    /* Converted once here rather than by QPainter each time it is tinted */
+    image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QMutexLocker locker(&m_mutex);
+    m_baseImages.insert(key, new QImage(image), imageCost(image));
+    return image;
+}
+
+QImage BlendedImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    QString fileName;
+    QColor color;
+    if (!parseId(id, &fileName, &color)) {
+        return QImage();
+    }
+
+    /* Merge baseUrl with fileName. If fileName is an absolute path, the result
+       will be fileName itself. */
+    fileName = m_baseUrl.resolved(QUrl::fromLocalFile(fileName)).toLocalFile();
+
+    QString key = cacheKey(fileName, requestedSize) + QString("\n%1").arg(color.rgba(), 8, 16);
+    {
+        QMutexLocker locker(&m_mutex);
+        QImage* cached = m_blendedImages.object(key);
+        if (cached != NULL) {
+            m_hitCount++;
+            if (size) {
+                *size = cached->size();
+            }
+            return *cached;
+        }
+        m_missCount++;
+    }
+
+    QImage image = loadImage(fileName, requestedSize);
+    if (image.isNull()) {
+        return image;
+    }
+
     if (size) {
         *size = image.size();
     }
@@ -97,5 +220,7 @@ QImage BlendedImageProvider::requestImage(const QString &id, QSize *size, const
     painter.fillRect(image.rect(), color);
     painter.end();
 
+    QMutexLocker locker(&m_mutex);
+    m_blendedImages.insert(key, new QImage(image), imageCost(image));
     return image;
 }
@@ -18,8 +18,26 @@
 #define BLENDEDIMAGEPROVIDER_H
 
 #include <QDeclarativeImageProvider>
+#include <QCache>
+#include <QColor>
+#include <QImage>
+#include <QMutex>
 #include <QUrl>
 
+/* Serves images tinted with a color, from an id of the form
+   [FILENAME]color=[COLORNAME]alpha=[FLOAT].
+
+   Images are kept in memory in two least recently used caches each with a
+   budget in bytes:
+   - the images loaded from disk and scaled to the requested size, keyed by
+     file and size, so that tinting them with another color does not read
+     and decode them again;
+   - the tinted images, keyed by file, size and color, so that the launcher
+     tiles which request the same few images over and over when scrolling
+     or hovered do no work at all.
+   Files are expected not to change once loaded.
+
+   Requests can come from the threads of asynchronous Image elements. */
 class BlendedImageProvider : public QDeclarativeImageProvider
 {
 public:
@@ -27,8 +45,29 @@ public:
     ~BlendedImageProvider();
     virtual QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
 
+    /* Maximum total size of the images kept, in bytes */
+    void setMemoryBudget(int bytes);
+    int memoryBudget() const;
+
+    /* Statistics: total size of the images currently kept, number of
+       requests served from memory and number that required tinting */
+    int memoryUsage() const;
+    int hitCount() const;
+    int missCount() const;
+
+    /* Splits id into the file name and color, the alpha being set on the
+       color. Returns false and warns if id is not valid. */
+    static bool parseId(const QString &id, QString *fileName, QColor *color);
+
 private:
+    QImage loadImage(const QString &fileName, const QSize &requestedSize);
+
     QUrl m_baseUrl;
+    mutable QMutex m_mutex;
+    QCache<QString, QImage> m_baseImages;
+    QCache<QString, QImage> m_blendedImages;
+    int m_hitCount;
+    int m_missCount;
 };
 
 #endif // BLENDEDIMAGEPROVIDER_H
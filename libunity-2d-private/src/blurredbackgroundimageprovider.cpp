@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "blurredbackgroundimageprovider.h"
+#include "windowgrabber.h"
+#include <debug_p.h>
+
+#include <QMutexLocker>
+#include <QRect>
+#include <QRegExp>
+#include <QStringList>
+#include <QVector>
+#include <QX11Info>
+
+#include <X11/Xlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const int DOWNSCALE_FACTOR = 4;
+/* Three passes of this radius on the downscaled image are close to the
+   blur radius of 12 pixels the dash used to apply at full size */
+static const int BLUR_RADIUS = 3;
+static const int BLUR_PASSES = 3;
+
+/* Averages each of the count pixels starting at line, stride pixels apart,
+   with its radius neighbours on each side. Pixels past the ends repeat the
+   first and last ones. buffer must hold count pixels. */
+#ifdef __SSE2__
+static void blurLine(quint32 *line, int count, int stride, int radius, quint32 *buffer)
+{
+    for (int i = 0; i < count; i++) {
+        buffer[i] = line[i * stride];
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    #define UNPACK(pixel) _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero)
+
+    const __m128 scale = _mm_set1_ps(1.0f / (2 * radius + 1));
+    __m128i sum = zero;
+    for (int i = -radius; i <= radius; i++) {
+        sum = _mm_add_epi32(sum, UNPACK(buffer[qBound(0, i, count - 1)]));
+    }
+    for (int x = 0; x < count; x++) {
+        __m128i average = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale));
+        average = _mm_packs_epi32(average, average);
+        line[x * stride] = _mm_cvtsi128_si32(_mm_packus_epi16(average, average));
+        sum = _mm_add_epi32(sum, UNPACK(buffer[qMin(x + radius + 1, count - 1)]));
+        sum = _mm_sub_epi32(sum, UNPACK(buffer[qMax(x - radius, 0)]));
+    }
+
+    #undef UNPACK
+}
+#else
+static void blurLine(quint32 *line, int count, int stride, int radius, quint32 *buffer)
+{
+    for (int i = 0; i < count; i++) {
+        buffer[i] = line[i * stride];
+    }
+
+    const float scale = 1.0f / (2 * radius + 1);
+    int sum[4] = { 0, 0, 0, 0 };
+    for (int i = -radius; i <= radius; i++) {
+        quint32 pixel = buffer[qBound(0, i, count - 1)];
+        for (int channel = 0; channel < 4; channel++) {
+            sum[channel] += (pixel >> (channel * 8)) & 0xff;
+        }
+    }
+    for (int x = 0; x < count; x++) {
+        quint32 average = 0;
+        quint32 in = buffer[qMin(x + radius + 1, count - 1)];
+        quint32 out = buffer[qMax(x - radius, 0)];
+        for (int channel = 0; channel < 4; channel++) {
+            average |= quint32(qRound(sum[channel] * scale)) << (channel * 8);
+            sum[channel] += ((in >> (channel * 8)) & 0xff) - ((out >> (channel * 8)) & 0xff);
+        }
+        line[x * stride] = average;
+    }
+}
+#endif
+
+BlurredBackgroundImageProvider::BlurredBackgroundImageProvider() :
+    QDeclarativeImageProvider(QDeclarativeImageProvider::Image),
+    m_grabber(NULL)
+{
+}
+
+BlurredBackgroundImageProvider::~BlurredBackgroundImageProvider()
+{
+    if (m_grabber != NULL) {
+        Display *display = m_grabber->display();
+        delete m_grabber;
+        XCloseDisplay(display);
+    }
+}
+
+void BlurredBackgroundImageProvider::blur(QImage *image, int radius)
+{
+    if (image->isNull() || image->depth() != 32 || radius < 1) {
+        return;
+    }
+
+    int width = image->width();
+    int height = image->height();
+    /* Scanlines of QImage are 32 bits aligned, so for 32 bits images the
+       pixels of a column are bytesPerLine / 4 pixels apart */
+    int stride = image->bytesPerLine() / 4;
+    quint32 *bits = reinterpret_cast<quint32*>(image->bits());
+    QVector<quint32> buffer(qMax(width, height));
+
+    for (int pass = 0; pass < BLUR_PASSES; pass++) {
+        for (int y = 0; y < height; y++) {
+            blurLine(bits + y * stride, width, 1, radius, buffer.data());
+        }
+        for (int x = 0; x < width; x++) {
+            blurLine(bits + x, height, stride, radius, buffer.data());
+        }
+    }
+}
+
+QImage BlurredBackgroundImageProvider::requestImage(const QString &id,
+                                                    QSize *size,
+                                                    const QSize &requestedSize)
+{
+    Q_UNUSED(requestedSize)
+
+    int atPos = id.indexOf('@');
+    QString area = (atPos == -1) ? id : id.left(atPos);
+
+    /* Parse "x,y,widthxheight" */
+    QStringList parts = area.split(QRegExp("[,x]"));
+    if (parts.count() != 4) {
+        UQ_WARNING << "Invalid background area:" << id;
+        return QImage();
+    }
+    QRect rect(parts[0].toInt(), parts[1].toInt(), parts[2].toInt(), parts[3].toInt());
+
+    QMutexLocker locker(&m_mutex);
+    if (m_grabber == NULL) {
+        /* The connection of Qt must not be used from the threads of
+           asynchronous Image elements */
+        Display *display = XOpenDisplay(DisplayString(QX11Info::display()));
+        if (display == NULL) {
+            UQ_WARNING << "Failed to open a connection to capture the background";
+            return QImage();
+        }
+        m_grabber = new WindowGrabber(display);
+    }
+
+    Display *display = m_grabber->display();
+    QImage image = m_grabber->grabArea(DefaultRootWindow(display), rect,
+                                       DOWNSCALE_FACTOR, true);
+    locker.unlock();
+
+    blur(&image, BLUR_RADIUS);
+    if (!image.isNull()) {
+        *size = image.size();
+    }
+    return image;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLURREDBACKGROUNDIMAGEPROVIDER_H
+#define BLURREDBACKGROUNDIMAGEPROVIDER_H
+
+#include <QDeclarativeImageProvider>
+#include <QImage>
+#include <QMutex>
+
+class WindowGrabber;
+
+/* Serves a blurred capture of an area of the screen, to be used as the
+   background of translucent windows such as the dash.
+
+   The id is the area of the screen, in the form "x,y,widthxheight". As with
+   the window image provider anything after a '@' is ignored, so that a
+   timestamp can be appended to force a new capture.
+
+   Only the area is captured, downscaled by the X server by a factor of 4
+   before being transferred. It is then blurred with a separable box filter
+   applied three times, which approximates a gaussian blur, and returned at
+   the downscaled size: the consumer is expected to scale it back up with
+   smoothing, which costs nothing noticeable on a blurred image.
+
+   Captures are done on a dedicated X connection so that the provider can
+   be used by asynchronous Image elements.
+*/
+class BlurredBackgroundImageProvider : public QDeclarativeImageProvider
+{
+public:
+    BlurredBackgroundImageProvider();
+    ~BlurredBackgroundImageProvider();
+
+    virtual QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
+
+    /* Blurs a 32 bits image in place. Each of the three passes averages
+       every pixel with its radius neighbours on each side. */
+    static void blur(QImage *image, int radius);
+
+private:
+    QMutex m_mutex;
+    WindowGrabber *m_grabber;
+};
+
+#endif // BLURREDBACKGROUNDIMAGEPROVIDER_H
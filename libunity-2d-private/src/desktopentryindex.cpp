@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "desktopentryindex.h"
+#include "desktopfilewatcher.h"
+
+// libunity-2d
+#include <debug_p.h>
+
+// Qt
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+// GLib
+#include <glib.h>
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+static const quint32 CACHE_MAGIC = 0x55324445; /* "U2DE" */
+/* To be bumped whenever the layout of the cache file changes */
+static const quint32 CACHE_FORMAT_VERSION = 1;
+
+/* Delay before rebuilding the index after a change, so that installing a
+   package rebuilds it once */
+static const int REBUILD_DELAY = 1000;
+
+static qint64 modificationTime(const QString& path)
+{
+    struct stat info;
+    if (stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return 0;
+    }
+    return qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+/* File name of the program run by the Exec line of a desktop file,
+   skipping a leading env and its variables */
+static QString executableName(const QString& exec)
+{
+    Q_FOREACH(QString argument, exec.split(' ', QString::SkipEmptyParts)) {
+        if (argument == "env" || argument.contains('=')) {
+            continue;
+        }
+        argument.remove('"');
+        return argument.section('/', -1);
+    }
+    return QString();
+}
+
+/* In order of precedence */
+static QStringList dataDirectories()
+{
+    QStringList directories;
+    directories.append(QString::fromUtf8(g_get_user_data_dir()));
+    for (const gchar* const* directory = g_get_system_data_dirs(); *directory != NULL; ++directory) {
+        directories.append(QString::fromUtf8(*directory));
+    }
+    return directories;
+}
+
+DesktopEntryIndex::DesktopEntryIndex(const QStringList& dataDirectories, const QString& cacheFile,
+                                     QObject* parent)
+    : QObject(parent)
+    , m_dataDirectories(dataDirectories)
+    , m_cacheFile(cacheFile)
+    , m_loadedFromCache(false)
+{
+    m_rebuildTimer.setSingleShot(true);
+    m_rebuildTimer.setInterval(REBUILD_DELAY);
+    connect(&m_rebuildTimer, SIGNAL(timeout()), SLOT(rebuild()));
+
+    m_loadedFromCache = load();
+    if (!m_loadedFromCache) {
+        scan();
+        save();
+    }
+    watchDirectories(true);
+}
+
+DesktopEntryIndex::~DesktopEntryIndex()
+{
+    watchDirectories(false);
+}
+
+DesktopEntryIndex* DesktopEntryIndex::instance()
+{
+    static DesktopEntryIndex* singleton = new DesktopEntryIndex(dataDirectories(), cacheFile());
+    return singleton;
+}
+
+QString DesktopEntryIndex::cacheFile()
+{
+    return QString::fromUtf8(g_get_user_cache_dir()) + "/unity-2d/desktop-entries";
+}
+
+QString DesktopEntryIndex::fileForId(const QString& id) const
+{
+    return m_fileForId.value(id);
+}
+
+QString DesktopEntryIndex::fileForExecutable(const QString& executable) const
+{
+    return m_fileForExecutable.value(executable.section('/', -1));
+}
+
+QString DesktopEntryIndex::fileForWMClass(const QString& wmClass) const
+{
+    return m_fileForWMClass.value(wmClass);
+}
+
+int DesktopEntryIndex::count() const
+{
+    return m_fileForId.count();
+}
+
+bool DesktopEntryIndex::loadedFromCache() const
+{
+    return m_loadedFromCache;
+}
+
+void DesktopEntryIndex::clear()
+{
+    m_directories.clear();
+    m_fileForId.clear();
+    m_fileForExecutable.clear();
+    m_fileForWMClass.clear();
+}
+
+void DesktopEntryIndex::rebuild()
+{
+    watchDirectories(false);
+    scan();
+    m_loadedFromCache = false;
+    save();
+    watchDirectories(true);
+    Q_EMIT changed();
+}
+
+void DesktopEntryIndex::scan()
+{
+    clear();
+    QSet<QString> seenIds;
+    QSet<QString> visited;
+    Q_FOREACH(const QString& dataDirectory, m_dataDirectories) {
+        scanDirectory(dataDirectory + "/applications", QString(), &seenIds, &visited);
+    }
+}
+
+void DesktopEntryIndex::onFileChanged(const QString& path)
+{
+    if (m_directories.contains(path)) {
+        m_rebuildTimer.start();
+    }
+}
+
+void DesktopEntryIndex::scanDirectory(const QString& directory, const QString& idPrefix,
+                                      QSet<QString>* seenIds, QSet<QString>* visited)
+{
+    m_directories.insert(directory, modificationTime(directory));
+
+    QDir dir(directory);
+    if (!dir.exists()) {
+        return;
+    }
+    /* Guard against symbolic links making loops */
+    QString canonicalPath = dir.canonicalPath();
+    if (visited->contains(canonicalPath)) {
+        return;
+    }
+    visited->insert(canonicalPath);
+
+    Q_FOREACH(const QFileInfo& info, dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot,
+                                                       QDir::Name)) {
+        if (info.isDir()) {
+            scanDirectory(info.filePath(), idPrefix + info.fileName() + "-", seenIds, visited);
+        } else if (info.fileName().endsWith(".desktop")) {
+            indexFile(info.filePath(), idPrefix + info.fileName(), seenIds);
+        }
+    }
+}
+
+void DesktopEntryIndex::indexFile(const QString& path, const QString& id, QSet<QString>* seenIds)
+{
+    if (seenIds->contains(id)) {
+        return;
+    }
+    /* Files that fail to be read or are hidden still hide the ones with the
+       same id in the next data directories */
+    seenIds->insert(id);
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    /* Only the few keys needed are read, the files are fully parsed by GIO
+       when they are used */
+    bool inDesktopEntry = false;
+    bool hidden = false;
+    QString exec;
+    QString wmClass;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (line.startsWith('[')) {
+            if (inDesktopEntry) {
+                break;
+            }
+            inDesktopEntry = (line == "[Desktop Entry]");
+            continue;
+        }
+        if (!inDesktopEntry) {
+            continue;
+        }
+        int separator = line.indexOf('=');
+        if (separator == -1) {
+            continue;
+        }
+        QByteArray key = line.left(separator).trimmed();
+        QByteArray value = line.mid(separator + 1).trimmed();
+        if (key == "Exec") {
+            exec = QString::fromUtf8(value);
+        } else if (key == "StartupWMClass") {
+            wmClass = QString::fromUtf8(value);
+        } else if (key == "Hidden") {
+            hidden = (value == "true");
+        }
+    }
+
+    if (hidden) {
+        return;
+    }
+    m_fileForId.insert(id, path);
+    QString executable = executableName(exec);
+    if (!executable.isEmpty() && !m_fileForExecutable.contains(executable)) {
+        m_fileForExecutable.insert(executable, path);
+    }
+    if (!wmClass.isEmpty() && !m_fileForWMClass.contains(wmClass)) {
+        m_fileForWMClass.insert(wmClass, path);
+    }
+}
+
+bool DesktopEntryIndex::load()
+{
+    if (m_cacheFile.isEmpty()) {
+        return false;
+    }
+
+    QFile file(m_cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+    quint32 magic;
+    quint32 version;
+    QStringList dataDirectories;
+    stream >> magic >> version;
+    if (magic != CACHE_MAGIC || version != CACHE_FORMAT_VERSION) {
+        return false;
+    }
+    stream >> dataDirectories >> m_directories;
+    if (stream.status() != QDataStream::Ok || dataDirectories != m_dataDirectories) {
+        m_directories.clear();
+        return false;
+    }
+
+    /* Any desktop file installed or removed since the cache was written
+       changed the modification time of its directory */
+    QHash<QString, qint64>::const_iterator it;
+    for (it = m_directories.constBegin(); it != m_directories.constEnd(); ++it) {
+        if (modificationTime(it.key()) != it.value()) {
+            m_directories.clear();
+            return false;
+        }
+    }
+
+    stream >> m_fileForId >> m_fileForExecutable >> m_fileForWMClass;
+    if (stream.status() != QDataStream::Ok) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+void DesktopEntryIndex::save() const
+{
+    if (m_cacheFile.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(m_cacheFile).path());
+    QString temporaryPath = QString("%1.%2").arg(m_cacheFile).arg(QCoreApplication::applicationPid());
+    QFile file(temporaryPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        UQ_WARNING << "Failed to write desktop entries cache" << temporaryPath;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+    stream << CACHE_MAGIC << CACHE_FORMAT_VERSION << m_dataDirectories << m_directories
+           << m_fileForId << m_fileForExecutable << m_fileForWMClass;
+    file.close();
+
+    /* Other processes may read the cache concurrently */
+    if (stream.status() != QDataStream::Ok
+        || ::rename(QFile::encodeName(temporaryPath).constData(),
+                    QFile::encodeName(m_cacheFile).constData()) != 0) {
+        QFile::remove(temporaryPath);
+    }
+}
+
+void DesktopEntryIndex::watchDirectories(bool watch)
+{
+    /* Watching a directory reports the files created, removed, moved or
+       modified in it */
+    DesktopFileWatcher* watcher = DesktopFileWatcher::instance();
+    QHash<QString, qint64>::const_iterator it;
+    for (it = m_directories.constBegin(); it != m_directories.constEnd(); ++it) {
+        if (it.value() == 0) {
+            continue;
+        }
+        if (watch) {
+            watcher->watch(it.key(), this, "onFileChanged");
+        } else {
+            watcher->unwatch(it.key(), this);
+        }
+    }
+}
+
+#include "desktopentryindex.moc"
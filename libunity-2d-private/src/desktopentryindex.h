@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DESKTOPENTRYINDEX_H
+#define DESKTOPENTRYINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+/* Index of the desktop files installed in the applications directories of
+   the XDG data directories, to find a desktop file from its id, the
+   executable it runs or its StartupWMClass with a single hash lookup.
+
+   Desktop file ids follow the XDG menu specification: the path of the file
+   relative to the applications directory, with slashes replaced by dashes
+   (wine-Programs-Foo.desktop for wine/Programs/Foo.desktop). Files of the
+   first data directories take precedence, as with GIO.
+
+   The index is saved to a cache file, that is used instead of reading all
+   the desktop files again as long as the modification times of all the
+   directories are unchanged. Those change whenever desktop files are
+   installed or removed, but not when a file is edited in place; changes
+   while running are followed by watching the directories, and the index is
+   then rebuilt. */
+class DesktopEntryIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DesktopEntryIndex* instance();
+
+    /* Index of the applications directories of dataDirectories, saved to
+       cacheFile if not empty */
+    DesktopEntryIndex(const QStringList& dataDirectories, const QString& cacheFile,
+                      QObject* parent = 0);
+    ~DesktopEntryIndex();
+
+    /* All return an empty string if there is no such desktop file */
+    QString fileForId(const QString& id) const;
+    /* Only the file name of the executable is used */
+    QString fileForExecutable(const QString& executable) const;
+    QString fileForWMClass(const QString& wmClass) const;
+
+    int count() const;
+    /* Whether the index was read from the cache file */
+    bool loadedFromCache() const;
+
+    static QString cacheFile();
+
+public Q_SLOTS:
+    void rebuild();
+
+Q_SIGNALS:
+    void changed();
+
+private Q_SLOTS:
+    void onFileChanged(const QString& path);
+
+private:
+    void clear();
+    void scan();
+    void scanDirectory(const QString& directory, const QString& idPrefix,
+                       QSet<QString>* seenIds, QSet<QString>* visited);
+    void indexFile(const QString& path, const QString& id, QSet<QString>* seenIds);
+    bool load();
+    void save() const;
+    void watchDirectories(bool watch);
+
+    QStringList m_dataDirectories;
+    QString m_cacheFile;
+    bool m_loadedFromCache;
+    QTimer m_rebuildTimer;
+
+    /* Modification time of every directory scanned, in nanoseconds, 0 when
+       it does not exist */
+    QHash<QString, qint64> m_directories;
+    QHash<QString, QString> m_fileForId;
+    QHash<QString, QString> m_fileForExecutable;
+    QHash<QString, QString> m_fileForWMClass;
+};
+
+#endif // DESKTOPENTRYINDEX_H
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "desktopfilewatcher.h"
+
+// libunity-2d
+#include <debug_p.h>
+
+// Qt
+#include <QFile>
+#include <QSet>
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* The events about the files in a directory only happen for watched
+   directories */
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB
+                                   | IN_MOVE_SELF | IN_DELETE_SELF
+                                   | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+DesktopFileWatcher::DesktopFileWatcher(QObject* parent)
+    : QObject(parent)
+    , m_notifier(NULL)
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd == -1) {
+        UQ_WARNING << "Failed to initialize inotify, desktop files will not be watched:"
+                   << strerror(errno);
+        return;
+    }
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, SIGNAL(activated(int)), SLOT(readEvents()));
+}
+
+DesktopFileWatcher::~DesktopFileWatcher()
+{
+    if (m_fd != -1) {
+        close(m_fd);
+    }
+}
+
+DesktopFileWatcher* DesktopFileWatcher::instance()
+{
+    static DesktopFileWatcher* singleton = new DesktopFileWatcher();
+    return singleton;
+}
+
+void DesktopFileWatcher::watch(const QString& path, QObject* receiver, const char* member)
+{
+    if (path.isEmpty()) {
+        return;
+    }
+    Receiver entry;
+    entry.object = receiver;
+    entry.member = member;
+    m_receivers.insert(path, entry);
+    if (m_references[path]++ == 0) {
+        addWatch(path);
+    }
+}
+
+void DesktopFileWatcher::unwatch(const QString& path, QObject* receiver)
+{
+    QHash<QString, int>::iterator it = m_references.find(path);
+    if (it == m_references.end()) {
+        return;
+    }
+
+    QMultiHash<QString, Receiver>::iterator receiverIt = m_receivers.find(path);
+    while (receiverIt != m_receivers.end() && receiverIt.key() == path) {
+        if (receiverIt.value().object == receiver) {
+            m_receivers.erase(receiverIt);
+            break;
+        }
+        ++receiverIt;
+    }
+
+    if (--it.value() == 0) {
+        m_references.erase(it);
+        removeWatch(path);
+    }
+}
+
+void DesktopFileWatcher::refresh(const QString& path)
+{
+    if (m_references.contains(path)) {
+        addWatch(path);
+    }
+}
+
+int DesktopFileWatcher::watchCount() const
+{
+    return m_descriptors.count();
+}
+
+void DesktopFileWatcher::addWatch(const QString& path)
+{
+    if (m_fd == -1) {
+        return;
+    }
+
+    /* Adding a watch on an inode already watched returns the same
+       descriptor, so this is cheap when the file did not change */
+    int wd = inotify_add_watch(m_fd, QFile::encodeName(path).constData(), WATCH_MASK);
+    if (wd == -1) {
+        UQ_WARNING << "Failed to watch" << path << ":" << strerror(errno);
+        removeWatch(path);
+        return;
+    }
+
+    QHash<QString, int>::const_iterator previous = m_descriptors.constFind(path);
+    if (previous != m_descriptors.constEnd() && previous.value() == wd) {
+        return;
+    }
+    removeWatch(path);
+    m_descriptors.insert(path, wd);
+    m_paths.insert(wd, path);
+}
+
+void DesktopFileWatcher::removeWatch(const QString& path)
+{
+    QHash<QString, int>::iterator it = m_descriptors.find(path);
+    if (it == m_descriptors.end()) {
+        return;
+    }
+    int wd = it.value();
+    m_descriptors.erase(it);
+    m_paths.remove(wd, path);
+    /* Paths linking to the same file share the descriptor. Removing it
+       fails harmlessly if the kernel already dropped it. */
+    if (!m_paths.contains(wd)) {
+        inotify_rm_watch(m_fd, wd);
+    }
+}
+
+void DesktopFileWatcher::readEvents()
+{
+    QSet<QString> changed;
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            QList<QString> paths = m_paths.values(event->wd);
+            Q_FOREACH(const QString& path, paths) {
+                changed.insert(path);
+            }
+            if (event->mask & IN_IGNORED) {
+                /* The file was removed or replaced, the watch is gone until
+                   refresh() adds it again */
+                Q_FOREACH(const QString& path, paths) {
+                    m_descriptors.remove(path);
+                }
+                m_paths.remove(event->wd);
+            }
+        }
+    }
+
+    Q_FOREACH(const QString& path, changed) {
+        notify(path);
+    }
+}
+
+void DesktopFileWatcher::notify(const QString& path)
+{
+    /* Receivers may watch or unwatch files when notified */
+    QList<Receiver> receivers = m_receivers.values(path);
+    Q_FOREACH(const Receiver& receiver, receivers) {
+        if (!receiver.object.isNull()) {
+            QMetaObject::invokeMethod(receiver.object, receiver.member.constData(),
+                                      Qt::DirectConnection, Q_ARG(QString, path));
+        }
+    }
+}
+
+#include "desktopfilewatcher.moc"
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DESKTOPFILEWATCHER_H
+#define DESKTOPFILEWATCHER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QHash>
+#include <QPointer>
+#include <QString>
+
+class QSocketNotifier;
+
+/* Process wide watcher of desktop files, multiplexing all the watches on a
+   single inotify descriptor.
+
+   Unlike a QFileSystemWatcher per watched file, watching a file or no
+   longer watching it is cheap and never blocks. Watches are reference
+   counted: a file is watched until unwatch() was called as many times as
+   watch() was for it.
+
+   Changes are only reported to the receivers watching the file that
+   changed, so that watching many files costs nothing to the receivers of
+   the others. All the changes to a file read at once from inotify are
+   reported with a single call. Directories can be watched too, files
+   created, removed, moved or modified in them being reported as changes of
+   the directory. */
+class DesktopFileWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DesktopFileWatcher* instance();
+    ~DesktopFileWatcher();
+
+    /* member is the name of a slot or invokable method of receiver, called
+       with the path when the file was modified, replaced or removed */
+    void watch(const QString& path, QObject* receiver, const char* member);
+    void unwatch(const QString& path, QObject* receiver);
+
+    /* Watches the file again if the watch was dropped, for example because
+       an editor replaced the file with a new one */
+    void refresh(const QString& path);
+
+    int watchCount() const;
+
+private Q_SLOTS:
+    void readEvents();
+
+private:
+    explicit DesktopFileWatcher(QObject* parent = 0);
+    void addWatch(const QString& path);
+    void removeWatch(const QString& path);
+    void notify(const QString& path);
+
+    struct Receiver
+    {
+        QPointer<QObject> object;
+        QByteArray member;
+    };
+
+    int m_fd;
+    QSocketNotifier* m_notifier;
+    QHash<QString, int> m_references;
+    QHash<QString, int> m_descriptors;
+    QMultiHash<int, QString> m_paths;
+    QMultiHash<QString, Receiver> m_receivers;
+};
+
+#endif // DESKTOPFILEWATCHER_H
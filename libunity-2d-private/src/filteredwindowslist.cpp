@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filteredwindowslist.h"
+#include "windowinfo.h"
+#include "windowslist.h"
+
+#include <QtAlgorithms>
+
+/* Orders windows as they are in the WindowsList */
+struct SourceOrder
+{
+    SourceOrder(WindowsList *windowsList) : m_windowsList(windowsList) {}
+
+    bool operator()(WindowInfo *left, WindowInfo *right) const
+    {
+        return m_windowsList->rowOf(left) < m_windowsList->rowOf(right);
+    }
+
+    WindowsList *m_windowsList;
+};
+
+FilteredWindowsList::FilteredWindowsList(QObject *parent) :
+    QAbstractListModel(parent),
+    m_windowsList(NULL),
+    m_filterByWorkspace(false),
+    m_workspace(-1)
+{
+    QHash<int, QByteArray> roles;
+    roles[WindowInfo::RoleWindowInfo] = "window";
+    roles[WindowInfo::RoleDesktopFile] = "desktopFile";
+    roles[WindowInfo::RoleWorkspace] = "workspace";
+    setRoleNames(roles);
+}
+
+int FilteredWindowsList::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+
+    return m_windows.size();
+}
+
+QVariant FilteredWindowsList::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || m_windowsList == NULL) {
+        return QVariant();
+    }
+
+    int sourceRow = m_windowsList->rowOf(m_windows.at(index.row()));
+    return m_windowsList->data(m_windowsList->index(sourceRow), role);
+}
+
+WindowsList* FilteredWindowsList::windows() const
+{
+    return m_windowsList;
+}
+
+QString FilteredWindowsList::applicationFilter() const
+{
+    return m_applicationFilter;
+}
+
+bool FilteredWindowsList::filterByWorkspace() const
+{
+    return m_filterByWorkspace;
+}
+
+int FilteredWindowsList::workspace() const
+{
+    return m_workspace;
+}
+
+void FilteredWindowsList::setWindows(WindowsList *windows)
+{
+    if (windows == m_windowsList) {
+        return;
+    }
+
+    if (m_windowsList != NULL) {
+        m_windowsList->disconnect(this);
+    }
+    m_windowsList = windows;
+    if (m_windowsList != NULL) {
+        connect(m_windowsList, SIGNAL(rowsInserted(QModelIndex,int,int)),
+                SLOT(onRowsInserted(QModelIndex,int,int)));
+        connect(m_windowsList, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+                SLOT(onRowsAboutToBeRemoved(QModelIndex,int,int)));
+        connect(m_windowsList, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+                SLOT(onDataChanged(QModelIndex,QModelIndex)));
+        connect(m_windowsList, SIGNAL(modelReset()), SLOT(refilter()));
+    }
+
+    refilter();
+    Q_EMIT windowsChanged(m_windowsList);
+}
+
+void FilteredWindowsList::setApplicationFilter(const QString &applicationFilter)
+{
+    if (applicationFilter != m_applicationFilter) {
+        m_applicationFilter = applicationFilter;
+        refilter();
+        Q_EMIT applicationFilterChanged(applicationFilter);
+    }
+}
+
+void FilteredWindowsList::setFilterByWorkspace(bool filterByWorkspace)
+{
+    if (filterByWorkspace != m_filterByWorkspace) {
+        m_filterByWorkspace = filterByWorkspace;
+        refilter();
+        Q_EMIT filterByWorkspaceChanged(filterByWorkspace);
+    }
+}
+
+void FilteredWindowsList::setWorkspace(int workspace)
+{
+    if (workspace != m_workspace) {
+        m_workspace = workspace;
+        if (m_filterByWorkspace) {
+            refilter();
+        }
+        Q_EMIT workspaceChanged(workspace);
+    }
+}
+
+bool FilteredWindowsList::matches(WindowInfo *window) const
+{
+    if (!m_applicationFilter.isEmpty() && window->desktopFile() != m_applicationFilter) {
+        return false;
+    }
+    if (m_filterByWorkspace) {
+        int workspace = window->workspace();
+        return workspace == m_workspace || workspace == -2;
+    }
+    return true;
+}
+
+QList<WindowInfo*> FilteredWindowsList::matchingWindows() const
+{
+    QList<WindowInfo*> windows;
+    if (m_windowsList == NULL) {
+        return windows;
+    }
+
+    /* Start from the smallest set of candidates the indexes give */
+    if (!m_applicationFilter.isEmpty()) {
+        Q_FOREACH(WindowInfo *window, m_windowsList->windowsForDesktopFile(m_applicationFilter)) {
+            if (matches(window)) {
+                windows.append(window);
+            }
+        }
+    } else if (m_filterByWorkspace) {
+        windows = m_windowsList->windowsOnWorkspace(m_workspace);
+        windows += m_windowsList->windowsOnWorkspace(-2);
+    } else {
+        for (int row = 0; row < m_windowsList->rowCount(); row++) {
+            windows.append(m_windowsList->at(row));
+        }
+        return windows;
+    }
+
+    qSort(windows.begin(), windows.end(), SourceOrder(m_windowsList));
+    return windows;
+}
+
+void FilteredWindowsList::refilter()
+{
+    QList<WindowInfo*> windows = matchingWindows();
+    QSet<WindowInfo*> matching = windows.toSet();
+
+    /* Only remove the windows that do not match anymore and add the ones
+       that were not there before, so that the delegates of the windows
+       matching both filters are left untouched */
+    for (int row = m_windows.count() - 1; row >= 0; row--) {
+        if (!matching.contains(m_windows.at(row))) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_contained.remove(m_windows.takeAt(row));
+            endRemoveRows();
+        }
+    }
+
+    QList<WindowInfo*> added;
+    Q_FOREACH(WindowInfo *window, windows) {
+        if (!m_contained.contains(window)) {
+            added.append(window);
+        }
+    }
+    appendWindows(added);
+}
+
+void FilteredWindowsList::appendWindows(const QList<WindowInfo*> &windows)
+{
+    if (windows.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), m_windows.count(), m_windows.count() + windows.count() - 1);
+    m_windows += windows;
+    Q_FOREACH(WindowInfo *window, windows) {
+        m_contained.insert(window);
+    }
+    endInsertRows();
+}
+
+void FilteredWindowsList::removeWindow(WindowInfo *window)
+{
+    int row = m_windows.indexOf(window);
+    if (row != -1) {
+        beginRemoveRows(QModelIndex(), row, row);
+        m_windows.removeAt(row);
+        m_contained.remove(window);
+        endRemoveRows();
+    }
+}
+
+void FilteredWindowsList::onRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent)
+
+    QList<WindowInfo*> added;
+    for (int row = first; row <= last; row++) {
+        WindowInfo *window = m_windowsList->at(row);
+        if (!m_contained.contains(window) && matches(window)) {
+            added.append(window);
+        }
+    }
+    appendWindows(added);
+}
+
+void FilteredWindowsList::onRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent)
+
+    for (int row = first; row <= last; row++) {
+        WindowInfo *window = m_windowsList->at(row);
+        if (m_contained.contains(window)) {
+            removeWindow(window);
+        }
+    }
+}
+
+void FilteredWindowsList::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    QList<WindowInfo*> added;
+    for (int sourceRow = topLeft.row(); sourceRow <= bottomRight.row(); sourceRow++) {
+        WindowInfo *window = m_windowsList->at(sourceRow);
+        bool contained = m_contained.contains(window);
+        if (matches(window)) {
+            if (contained) {
+                QModelIndex changedItem = index(m_windows.indexOf(window));
+                Q_EMIT dataChanged(changedItem, changedItem);
+            } else {
+                added.append(window);
+            }
+        } else if (contained) {
+            removeWindow(window);
+        }
+    }
+    appendWindows(added);
+}
+
+#include "filteredwindowslist.moc"
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILTEREDWINDOWSLIST_H
+#define FILTEREDWINDOWSLIST_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QtDeclarative/qdeclarative.h>
+
+class WindowInfo;
+class WindowsList;
+
+/* The windows of a WindowsList that belong to an application and/or are
+   on a workspace.
+
+   Unlike a chain of SortFilterProxyModels it does not test every window
+   when the filter changes: the matching windows are looked up in the
+   indexes of WindowsList, and only the windows entering or leaving the
+   result generate row insertions and removals.
+*/
+class FilteredWindowsList : public QAbstractListModel
+{
+    Q_OBJECT
+
+    Q_PROPERTY(WindowsList* windows READ windows WRITE setWindows NOTIFY windowsChanged)
+    /* Desktop file of the application whose windows are kept, or an empty
+       string to keep the windows of all applications */
+    Q_PROPERTY(QString applicationFilter READ applicationFilter WRITE setApplicationFilter
+                                         NOTIFY applicationFilterChanged)
+    /* If true, only the windows on workspace and the ones pinned to all
+       workspaces are kept */
+    Q_PROPERTY(bool filterByWorkspace READ filterByWorkspace WRITE setFilterByWorkspace
+                                      NOTIFY filterByWorkspaceChanged)
+    Q_PROPERTY(int workspace READ workspace WRITE setWorkspace NOTIFY workspaceChanged)
+
+public:
+    FilteredWindowsList(QObject *parent = 0);
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    /* getters */
+    WindowsList* windows() const;
+    QString applicationFilter() const;
+    bool filterByWorkspace() const;
+    int workspace() const;
+
+    /* setters */
+    void setWindows(WindowsList *windows);
+    void setApplicationFilter(const QString &applicationFilter);
+    void setFilterByWorkspace(bool filterByWorkspace);
+    void setWorkspace(int workspace);
+
+Q_SIGNALS:
+    void windowsChanged(WindowsList *windows);
+    void applicationFilterChanged(const QString &applicationFilter);
+    void filterByWorkspaceChanged(bool filterByWorkspace);
+    void workspaceChanged(int workspace);
+
+private Q_SLOTS:
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void refilter();
+
+private:
+    bool matches(WindowInfo *window) const;
+    QList<WindowInfo*> matchingWindows() const;
+    void appendWindows(const QList<WindowInfo*> &windows);
+    void removeWindow(WindowInfo *window);
+
+    WindowsList *m_windowsList;
+    QString m_applicationFilter;
+    bool m_filterByWorkspace;
+    int m_workspace;
+    QList<WindowInfo*> m_windows;
+    QSet<WindowInfo*> m_contained;
+};
+
+QML_DECLARE_TYPE(FilteredWindowsList)
+
+#endif // FILTEREDWINDOWSLIST_H
@@ -32,9 +32,79 @@
 // GTK
 #include <gtk/gtk.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace GImageUtils
 {
 
+/* Pixbufs store their pixels as R, G, B(, A) bytes whatever the byte order
+   of the machine is, with unpremultiplied alpha. */
+
+static void convertRgbLine(const uchar* source, QRgb* destination, int count)
+{
+    for (int x = 0; x < count; ++x, source += 3) {
+        destination[x] = qRgb(source[0], source[1], source[2]);
+    }
+}
+
+/* Same rounding as the raster paint engine */
+static inline uint premultiply(uint channel, uint alpha)
+{
+    uint product = channel * alpha;
+    return (product + (product >> 8) + 0x80) >> 8;
+}
+
+static void convertRgbaLineScalar(const uchar* source, QRgb* destination, int count)
+{
+    for (int x = 0; x < count; ++x, source += 4) {
+        uint alpha = source[3];
+        destination[x] = qRgba(premultiply(source[0], alpha), premultiply(source[1], alpha),
+                               premultiply(source[2], alpha), alpha);
+    }
+}
+
+#if defined(__SSE2__) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+/* Converts two pixels unpacked to 16 bits per channel: swaps red and blue
+   and premultiplies them with the same rounding as premultiply() */
+static inline __m128i premultiplyPixels(__m128i pixels, __m128i alphaMask, __m128i opaqueAlpha)
+{
+    pixels = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 0, 1, 2));
+    pixels = _mm_shufflehi_epi16(pixels, _MM_SHUFFLE(3, 0, 1, 2));
+    __m128i alpha = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    /* Multiplying alpha by 255 leaves it unchanged once rounded */
+    alpha = _mm_or_si128(_mm_andnot_si128(alphaMask, alpha), opaqueAlpha);
+
+    __m128i product = _mm_mullo_epi16(pixels, alpha);
+    product = _mm_add_epi16(product, _mm_srli_epi16(product, 8));
+    product = _mm_add_epi16(product, _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(product, 8);
+}
+
+static void convertRgbaLine(const uchar* source, QRgb* destination, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i opaqueAlpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 4));
+        __m128i low = premultiplyPixels(_mm_unpacklo_epi8(pixels, zero), alphaMask, opaqueAlpha);
+        __m128i high = premultiplyPixels(_mm_unpackhi_epi8(pixels, zero), alphaMask, opaqueAlpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm_packus_epi16(low, high));
+    }
+    convertRgbaLineScalar(source + x * 4, destination + x, count - x);
+}
+#else
+static void convertRgbaLine(const uchar* source, QRgb* destination, int count)
+{
+    convertRgbaLineScalar(source, destination, count);
+}
+#endif
+
 QImage imageForIconString(const QString& name, int size, GtkIconTheme* theme)
 {
     if (!theme) {
@@ -69,34 +139,44 @@ QImage imageForIconString(const QString& name, int size, GtkIconTheme* theme)
     return imageForPixbuf(pixbuf.data());
 }
 
-QImage imageForPixbuf(const GdkPixbuf* pixbuf)
+QImage imageForPixbuf(const GdkPixbuf* pixbuf, bool allowSimd)
 {
-    QImage image(gdk_pixbuf_get_pixels(pixbuf),
-                   gdk_pixbuf_get_width(pixbuf),
-                   gdk_pixbuf_get_height(pixbuf),
-                   gdk_pixbuf_get_rowstride(pixbuf),
-                   QImage::Format_ARGB32);
-
-#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
-    /* ABGR → ARGB */
-    QImage swappedImage = image.rgbSwapped();
-#else
-    /* ABGR → BGRA */
-    /* Reference: https://bugs.launchpad.net/unity-2d/+bug/758782 */
-    QImage swappedImage(image.size(), image.format());
-    for (int i = 0; i < swappedImage.height(); ++i) {
-        QRgb* p = (QRgb*) image.constScanLine(i);
-        QRgb* q = (QRgb*) swappedImage.scanLine(i);
-        QRgb* end = p + image.width();
-        while (p < end) {
-            *q = qRgba(qAlpha(*p), qRed(*p), qGreen(*p), qBlue(*p));
-            p++;
-            q++;
-        }
+    if (gdk_pixbuf_get_colorspace(pixbuf) != GDK_COLORSPACE_RGB
+        || gdk_pixbuf_get_bits_per_sample(pixbuf) != 8) {
+        UQ_WARNING << "Unsupported pixbuf format";
+        return QImage();
     }
-#endif
 
-    return swappedImage;
+    int width = gdk_pixbuf_get_width(pixbuf);
+    int height = gdk_pixbuf_get_height(pixbuf);
+    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    bool hasAlpha = gdk_pixbuf_get_has_alpha(pixbuf);
+    int channels = gdk_pixbuf_get_n_channels(pixbuf);
+    if (channels != (hasAlpha ? 4 : 3)) {
+        UQ_WARNING << "Unsupported number of channels in pixbuf:" << channels;
+        return QImage();
+    }
+    const uchar* pixels = gdk_pixbuf_get_pixels(pixbuf);
+
+    /* Converted in a single pass straight into an image in the format
+       QPainter works with, so that it is not converted again when drawn */
+    QImage image(width, height, hasAlpha ? QImage::Format_ARGB32_Premultiplied
+                                         : QImage::Format_RGB32);
+    if (image.isNull()) {
+        return image;
+    }
+    for (int y = 0; y < height; ++y) {
+        const uchar* source = pixels + y * rowstride;
+        QRgb* destination = reinterpret_cast<QRgb*>(image.scanLine(y));
+        if (hasAlpha && allowSimd) {
+            convertRgbaLine(source, destination, width);
+        } else if (hasAlpha) {
+            convertRgbaLineScalar(source, destination, width);
+        } else {
+            convertRgbLine(source, destination, width);
+        }
+    }
+    return image;
 }
 
 } // namespace
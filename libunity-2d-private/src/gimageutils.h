@@ -39,7 +39,9 @@ namespace GImageUtils
 
 QImage imageForIconString(const QString& name, int size, struct _GtkIconTheme* theme = 0);
 
-QImage imageForPixbuf(const struct _GdkPixbuf* pixbuf);
+/* The pixels with alpha are converted with SIMD instructions if available
+   unless allowSimd is false, both paths give exactly the same results. */
+QImage imageForPixbuf(const struct _GdkPixbuf* pixbuf, bool allowSimd = true);
 
 } // namespace
 
@@ -41,6 +41,8 @@ static const char* SM_CLIENT_DBUS_INTERFACE = "org.gnome.SessionManager.ClientPr
 // Number of seconds to wait for gnome-session to call us back
 static const int MAX_END_SESSION_WAIT = 3;
 
+static GnomeSessionClient* sInstance = NULL;
+
 struct GnomeSessionClientPrivate
 {
     GnomeSessionClientPrivate(const QString& applicationId)
@@ -75,13 +77,22 @@ GnomeSessionClient::GnomeSessionClient(const QString& applicationId, QObject* pa
     d->m_waitingForEndSession = false;
     connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()),
         SLOT(waitForEndSession()));
+    sInstance = this;
 }
 
 GnomeSessionClient::~GnomeSessionClient()
 {
+    if (sInstance == this) {
+        sInstance = NULL;
+    }
     delete d;
 }
 
+GnomeSessionClient* GnomeSessionClient::instance()
+{
+    return sInstance;
+}
+
 void GnomeSessionClient::connectToSessionManager()
 {
     QString startupId = QString::fromLocal8Bit(qgetenv("DESKTOP_AUTOSTART_ID"));
@@ -129,6 +140,7 @@ void GnomeSessionClient::stop()
 void GnomeSessionClient::queryEndSession()
 {
     UQ_DEBUG;
+    Q_EMIT sessionEnding();
     if (!d->sendEndSessionResponse()) {
       d->m_waitingForEndSession = false;
     }
@@ -137,6 +149,7 @@ void GnomeSessionClient::queryEndSession()
 void GnomeSessionClient::endSession()
 {
     UQ_DEBUG;
+    Q_EMIT sessionEnding();
     d->sendEndSessionResponse();
     d->m_waitingForEndSession = false;
     QCoreApplication::quit();
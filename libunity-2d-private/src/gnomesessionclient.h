@@ -45,8 +45,22 @@ public:
     GnomeSessionClient(const QString& applicationId, QObject* parent = 0);
     ~GnomeSessionClient();
 
+    /**
+     * The client of the application, or NULL if none was created
+     */
+    static GnomeSessionClient* instance();
+
     void connectToSessionManager();
 
+Q_SIGNALS:
+    /**
+     * Emitted when gnome-session asks whether the session can end and when
+     * it ends, before answering it: once answered the session may end at
+     * any time. Slots connected to it must save what needs to be saved
+     * before returning.
+     */
+    void sessionEnding();
+
 private Q_SLOTS:
     void slotRegisterClientFinished(QDBusPendingCallWatcher* watcher);
     void stop();
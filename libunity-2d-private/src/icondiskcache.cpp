@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// GTK
+#include <gtk/gtk.h>
+
+// Self
+#include "icondiskcache.h"
+
+// Local
+#include <debug_p.h>
+#include <gimageutils.h>
+
+// Qt
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QtAlgorithms>
+
+// libc
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char ICON_MAGIC[4] = { 'U', '2', 'D', 'I' };
+/* To be bumped whenever the layout of the files changes */
+static const quint32 ICON_FORMAT_VERSION = 1;
+/* Size of the icon files kept mapped by a process. Going over it unmaps
+   the least recently used icons no longer referenced down to 3/4 of it. */
+static const qint64 MAPPED_ICONS_BUDGET = 16 * 1024 * 1024;
+
+struct IconHeader
+{
+    char magic[4];
+    quint32 formatVersion;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+};
+
+/* An icon file mapped in memory, and the image using its pixels */
+struct MappedIcon
+{
+    QImage image;
+    uchar* data;
+    size_t length;
+    quint64 lastUse;
+};
+
+struct IconDiskCachePrivate
+{
+    IconDiskCachePrivate()
+    : m_mappedBytes(0)
+    , m_useCount(0)
+    , m_hitCount(0)
+    , m_missCount(0)
+    {}
+
+    QString currentThemeName(const QString& themeName) const;
+    QString computeThemeVersion(const QString& themeName) const;
+    QString iconPath(const QString& themeName, const QString& name, int size);
+    void removeOtherVersions(const QString& themeDirectory);
+    bool mapIcon(const QString& path, MappedIcon* icon);
+    void unmapIcon(MappedIcon* icon);
+    void evictIcons();
+
+    QMutex m_mutex;
+    /* Directory of the current version of each theme */
+    QHash<QString, QString> m_themeDirectories;
+    /* Icons mapped, by path. QImage does not own the pixels, so an icon is
+       only unmapped once the images handed out for it were all destroyed,
+       which is the case when the one of the cache is detached. */
+    QHash<QString, MappedIcon> m_icons;
+    /* Icons of previous versions of the themes still used */
+    QList<MappedIcon> m_retiredIcons;
+    qint64 m_mappedBytes;
+    quint64 m_useCount;
+    int m_hitCount;
+    int m_missCount;
+};
+
+QString IconDiskCachePrivate::currentThemeName(const QString& themeName) const
+{
+    if (!themeName.isEmpty()) {
+        return themeName;
+    }
+    gchar* name = NULL;
+    g_object_get(gtk_settings_get_default(), "gtk-icon-theme-name", &name, NULL);
+    QString defaultName = QString::fromUtf8(name);
+    g_free(name);
+    return defaultName.isEmpty() ? QString("hicolor") : defaultName;
+}
+
+/* The most recent modification time of the directories of the theme and of
+   the themes it inherits from, in all the icon directories */
+QString IconDiskCachePrivate::computeThemeVersion(const QString& themeName) const
+{
+    gchar** searchPath = NULL;
+    gint count = 0;
+    gtk_icon_theme_get_search_path(gtk_icon_theme_get_default(), &searchPath, &count);
+    QStringList directories;
+    for (int i = 0; i < count; i++) {
+        directories << QString::fromUtf8(searchPath[i]);
+    }
+    g_strfreev(searchPath);
+
+    uint lastModified = 0;
+    QStringList themes = QStringList() << themeName << "hicolor";
+    QSet<QString> visited;
+    while (!themes.isEmpty()) {
+        QString theme = themes.takeFirst();
+        if (visited.contains(theme)) {
+            continue;
+        }
+        visited.insert(theme);
+
+        Q_FOREACH(const QString& directory, directories) {
+            QString themePath = directory + "/" + theme;
+            QFileInfo themeInfo(themePath);
+            if (!themeInfo.isDir()) {
+                continue;
+            }
+            lastModified = qMax(lastModified, themeInfo.lastModified().toTime_t());
+            QFileInfo cacheInfo(themePath + "/icon-theme.cache");
+            if (cacheInfo.exists()) {
+                lastModified = qMax(lastModified, cacheInfo.lastModified().toTime_t());
+            }
+
+            GKeyFile* keyFile = g_key_file_new();
+            QByteArray indexPath = QFile::encodeName(themePath + "/index.theme");
+            if (g_key_file_load_from_file(keyFile, indexPath.constData(), G_KEY_FILE_NONE, NULL)) {
+                gchar** inherits = g_key_file_get_string_list(keyFile, "Icon Theme", "Inherits",
+                                                              NULL, NULL);
+                for (int i = 0; inherits != NULL && inherits[i] != NULL; i++) {
+                    themes << QString::fromUtf8(inherits[i]);
+                }
+                g_strfreev(inherits);
+            }
+            g_key_file_free(keyFile);
+        }
+    }
+    return QString::number(lastModified, 16);
+}
+
+QString IconDiskCachePrivate::iconPath(const QString& themeName, const QString& name, int size)
+{
+    QString directory = m_themeDirectories.value(themeName);
+    if (directory.isEmpty()) {
+        directory = IconDiskCache::cacheDirectory() + "/" + themeName + "/"
+                    + computeThemeVersion(themeName);
+        m_themeDirectories.insert(themeName, directory);
+        removeOtherVersions(directory);
+    }
+    /* Icon strings can be serialized GIcons, not suitable as file names */
+    QByteArray hash = QCryptographicHash::hash(name.toUtf8(), QCryptographicHash::Md5).toHex();
+    return QString("%1/%2-%3.icon").arg(directory).arg(QString::fromLatin1(hash)).arg(size);
+}
+
+/* Icons of previous versions are never used again. Processes that still
+   have some of them mapped keep them until they unmap them. */
+void IconDiskCachePrivate::removeOtherVersions(const QString& themeDirectory)
+{
+    QFileInfo current(themeDirectory);
+    QDir themeDir = current.dir();
+    Q_FOREACH(const QString& version, themeDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (version == current.fileName()) {
+            continue;
+        }
+        QDir versionDir(themeDir.filePath(version));
+        Q_FOREACH(const QString& file, versionDir.entryList(QDir::Files | QDir::Hidden)) {
+            versionDir.remove(file);
+        }
+        themeDir.rmdir(version);
+    }
+}
+
+bool IconDiskCachePrivate::mapIcon(const QString& path, MappedIcon* icon)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    /* The mapping stays valid once the file is closed, descriptors are not
+       held for every icon */
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= qint64(sizeof(IconHeader))) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const IconHeader* header = static_cast<const IconHeader*>(data);
+    qint64 expectedSize = qint64(sizeof(IconHeader)) + qint64(header->bytesPerLine) * header->height;
+    if (memcmp(header->magic, ICON_MAGIC, sizeof(ICON_MAGIC)) != 0
+        || header->formatVersion != ICON_FORMAT_VERSION
+        || info.st_size != expectedSize
+        || header->format == QImage::Format_Invalid) {
+        UQ_WARNING << "Ignoring invalid cached icon" << path;
+        munmap(data, info.st_size);
+        return false;
+    }
+
+    /* The const constructor makes QImage copy the pixels before any
+       modification, so the mapping can be read only */
+    icon->data = static_cast<uchar*>(data);
+    icon->length = info.st_size;
+    icon->image = QImage(static_cast<const uchar*>(icon->data) + sizeof(IconHeader),
+                         header->width, header->height,
+                         header->bytesPerLine, QImage::Format(header->format));
+    icon->lastUse = ++m_useCount;
+    m_mappedBytes += icon->length;
+    return true;
+}
+
+void IconDiskCachePrivate::unmapIcon(MappedIcon* icon)
+{
+    icon->image = QImage();
+    munmap(icon->data, icon->length);
+    m_mappedBytes -= icon->length;
+}
+
+void IconDiskCachePrivate::evictIcons()
+{
+    QList<MappedIcon>::iterator retired = m_retiredIcons.begin();
+    while (retired != m_retiredIcons.end()) {
+        if (retired->image.isDetached()) {
+            unmapIcon(&*retired);
+            retired = m_retiredIcons.erase(retired);
+        } else {
+            ++retired;
+        }
+    }
+
+    if (m_mappedBytes <= MAPPED_ICONS_BUDGET) {
+        return;
+    }
+
+    QList<QPair<quint64, QString> > candidates;
+    QHash<QString, MappedIcon>::iterator it;
+    for (it = m_icons.begin(); it != m_icons.end(); ++it) {
+        if (it->image.isDetached()) {
+            candidates.append(qMakePair(it->lastUse, it.key()));
+        }
+    }
+    qSort(candidates);
+
+    for (int i = 0; i < candidates.count() && m_mappedBytes > MAPPED_ICONS_BUDGET * 3 / 4; i++) {
+        it = m_icons.find(candidates.at(i).second);
+        unmapIcon(&*it);
+        m_icons.erase(it);
+    }
+}
+
+IconDiskCache::IconDiskCache()
+: d(new IconDiskCachePrivate)
+{
+}
+
+IconDiskCache::~IconDiskCache()
+{
+    QHash<QString, MappedIcon>::iterator it;
+    for (it = d->m_icons.begin(); it != d->m_icons.end(); ++it) {
+        d->unmapIcon(&*it);
+    }
+    QList<MappedIcon>::iterator retired;
+    for (retired = d->m_retiredIcons.begin(); retired != d->m_retiredIcons.end(); ++retired) {
+        d->unmapIcon(&*retired);
+    }
+    delete d;
+}
+
+IconDiskCache* IconDiskCache::instance()
+{
+    static IconDiskCache* cache = new IconDiskCache();
+    return cache;
+}
+
+QString IconDiskCache::cacheDirectory()
+{
+    return QString::fromUtf8(g_get_user_cache_dir()) + "/unity-2d/icons";
+}
+
+QString IconDiskCache::themeDirectory(const QString& themeName)
+{
+    QMutexLocker locker(&d->m_mutex);
+    return QFileInfo(d->iconPath(d->currentThemeName(themeName), QString(), 0)).path();
+}
+
+void IconDiskCache::invalidateTheme(const QString& themeName)
+{
+    QMutexLocker locker(&d->m_mutex);
+    QString directory = d->m_themeDirectories.take(d->currentThemeName(themeName));
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    /* Icons of the previous version are unmapped once no longer used */
+    QHash<QString, MappedIcon>::iterator it = d->m_icons.begin();
+    while (it != d->m_icons.end()) {
+        if (it.key().startsWith(directory + "/")) {
+            d->m_retiredIcons.append(it.value());
+            it = d->m_icons.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    d->evictIcons();
+}
+
+QImage IconDiskCache::image(const QString& themeName, const QString& name, int size)
+{
+    QMutexLocker locker(&d->m_mutex);
+    QString path = d->iconPath(d->currentThemeName(themeName), name, size);
+    QHash<QString, MappedIcon>::iterator it = d->m_icons.find(path);
+    if (it == d->m_icons.end()) {
+        MappedIcon icon;
+        if (!d->mapIcon(path, &icon)) {
+            d->m_missCount++;
+            return QImage();
+        }
+        /* Evicting first, the new icon is not referenced outside yet */
+        d->evictIcons();
+        it = d->m_icons.insert(path, icon);
+    }
+
+    d->m_hitCount++;
+    it->lastUse = ++d->m_useCount;
+    return it->image;
+}
+
+bool IconDiskCache::insert(const QString& themeName, const QString& name, int size,
+                           const QImage& image)
+{
+    if (image.isNull() || image.depth() != 32) {
+        return false;
+    }
+
+    QString path;
+    {
+        QMutexLocker locker(&d->m_mutex);
+        path = d->iconPath(d->currentThemeName(themeName), name, size);
+    }
+
+    QDir().mkpath(QFileInfo(path).path());
+    QString temporaryPath = QString("%1.%2").arg(path).arg(QCoreApplication::applicationPid());
+    QFile file(temporaryPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        UQ_WARNING << "Failed to write cached icon" << temporaryPath;
+        return false;
+    }
+
+    IconHeader header;
+    memcpy(header.magic, ICON_MAGIC, sizeof(ICON_MAGIC));
+    header.formatVersion = ICON_FORMAT_VERSION;
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = image.format();
+    bool written = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+                   && file.write(reinterpret_cast<const char*>(image.constBits()), image.byteCount())
+                      == image.byteCount();
+    file.close();
+
+    /* rename() atomically replaces a file another process may have written
+       meanwhile, mappings of the previous one stay valid */
+    if (!written || ::rename(QFile::encodeName(temporaryPath).constData(),
+                             QFile::encodeName(path).constData()) != 0) {
+        QFile::remove(temporaryPath);
+        return false;
+    }
+    return true;
+}
+
+QImage IconDiskCache::imageForIconString(const QString& name, int size,
+                                         struct _GtkIconTheme* theme,
+                                         const QString& themeName)
+{
+    if (size <= 0) {
+        return GImageUtils::imageForIconString(name, size, theme);
+    }
+
+    QImage cached = image(themeName, name, size);
+    if (!cached.isNull()) {
+        return cached;
+    }
+
+    QImage loaded = GImageUtils::imageForIconString(name, size, theme);
+    insert(themeName, name, size, loaded);
+    return loaded;
+}
+
+int IconDiskCache::hitCount() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_hitCount;
+}
+
+int IconDiskCache::missCount() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_missCount;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICONDISKCACHE_H
+#define ICONDISKCACHE_H
+
+// Qt
+#include <QImage>
+#include <QString>
+
+struct _GtkIconTheme;
+struct IconDiskCachePrivate;
+
+/**
+ * Persistent cache of decoded theme icons, shared by all the unity-2d
+ * processes.
+ *
+ * Every icon is stored, already decoded, in its own file under
+ * $XDG_CACHE_HOME/unity-2d/icons/<theme>/<version>/. Files are memory mapped
+ * and the images returned use the mapped pixels directly, so icons are not
+ * decoded again and the processes showing the same icons share the pages.
+ *
+ * The version of a theme is derived from the modification times of its
+ * directories and of the ones of the themes it inherits from, which change
+ * whenever icons are installed or removed (gtk-update-icon-cache rewrites
+ * icon-theme.cache). A new version simply means a new, empty directory.
+ * Directories of the previous versions are removed when a new one is used.
+ *
+ * Mappings are bounded: the least recently used icons are unmapped once
+ * none of the images returned for them is alive anymore.
+ *
+ * Files are written under a temporary name then renamed, so that processes
+ * reading the cache concurrently never see a partially written icon, and
+ * images mapped from a replaced file stay valid.
+ */
+class IconDiskCache
+{
+public:
+    static IconDiskCache* instance();
+
+    /**
+     * Same as GImageUtils::imageForIconString, but icons are read from the
+     * cache when they are there, and added to it otherwise.
+     * themeName must be the name of theme, or empty if theme is the default
+     * theme (or NULL).
+     */
+    QImage imageForIconString(const QString& name, int size,
+                              struct _GtkIconTheme* theme = 0,
+                              const QString& themeName = QString());
+
+    /**
+     * Returns the icon if it is in the cache for the current version of the
+     * theme, a null image otherwise. An empty themeName means the default
+     * theme.
+     */
+    QImage image(const QString& themeName, const QString& name, int size);
+    bool insert(const QString& themeName, const QString& name, int size, const QImage& image);
+
+    /**
+     * Computes the version of the theme again the next time it is used, to
+     * be called when the theme changed.
+     */
+    void invalidateTheme(const QString& themeName);
+
+    /* Directory of the current version of the theme */
+    QString themeDirectory(const QString& themeName);
+    static QString cacheDirectory();
+
+    /* Statistics */
+    int hitCount() const;
+    int missCount() const;
+
+private:
+    IconDiskCache();
+    ~IconDiskCache();
+    Q_DISABLE_COPY(IconDiskCache)
+
+    IconDiskCachePrivate* const d;
+};
+
+#endif // ICONDISKCACHE_H
@@ -21,24 +21,172 @@
 #include "config.h"
 
 #include <QFile>
+#include <QMutexLocker>
 
 #include <debug_p.h>
 #include <gimageutils.h>
+#include <icondiskcache.h>
 
 static const char* UNITY_RES_PATH = "/usr/share/unity/";
 
+static const int DEFAULT_MEMORY_BUDGET = 8 * 1024 * 1024;
+/* Part of the budget used by the icons loaded from files at their
+   original size */
+static const int FILE_IMAGES_BUDGET_RATIO = 4;
+
+/* Name under which icons of the default theme are cached. It is not a
+   valid theme name, so it does not clash with themes asked explicitly. */
+static const char* DEFAULT_THEME_KEY = "*";
+
+static QString cacheKey(const QString& themeName, const QString& iconName, const QSize& size)
+{
+    return QString("%1\n%2\n%3x%4").arg(themeName).arg(iconName)
+                                   .arg(size.width()).arg(size.height());
+}
+
+/* Null images are cached too so that missing icons are not looked up on
+   every request, they cost as much as an empty entry */
+static int imageCost(const QImage& image)
+{
+    return qMax(1, image.byteCount());
+}
+
+static void onThemeChanged(GtkIconTheme* theme, gpointer data)
+{
+    IconImageProvider* provider = static_cast<IconImageProvider*>(data);
+    QString themeName = (theme == gtk_icon_theme_get_default()) ?
+                        DEFAULT_THEME_KEY : QString::fromUtf8(
+                            static_cast<const char*>(g_object_get_data(G_OBJECT(theme), "unity-2d-theme-name")));
+    provider->invalidateTheme(themeName);
+    IconDiskCache::instance()->invalidateTheme(theme == gtk_icon_theme_get_default() ?
+                                               QString() : themeName);
+}
+
 IconImageProvider::IconImageProvider() : QDeclarativeImageProvider(QDeclarativeImageProvider::Image)
+    , m_hitCount(0)
+    , m_missCount(0)
 {
+    setMemoryBudget(DEFAULT_MEMORY_BUDGET);
+    g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                     G_CALLBACK(onThemeChanged), this);
 }
 
 IconImageProvider::~IconImageProvider()
 {
+    g_signal_handlers_disconnect_by_func(gtk_icon_theme_get_default(),
+                                         (gpointer)onThemeChanged, this);
     /* unreference cached themes */
     Q_FOREACH(void* theme, m_themes.values()) {
+        g_signal_handlers_disconnect_by_func(theme, (gpointer)onThemeChanged, this);
         g_object_unref((GtkIconTheme*)theme);
     }
 }
 
+void IconImageProvider::setMemoryBudget(int bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    int fileImagesBudget = bytes / FILE_IMAGES_BUDGET_RATIO;
+    m_fileImages.setMaxCost(fileImagesBudget);
+    m_images.setMaxCost(bytes - fileImagesBudget);
+}
+
+int IconImageProvider::memoryBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_images.maxCost() + m_fileImages.maxCost();
+}
+
+int IconImageProvider::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_images.totalCost() + m_fileImages.totalCost();
+}
+
+int IconImageProvider::hitCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hitCount;
+}
+
+int IconImageProvider::missCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_missCount;
+}
+
+void IconImageProvider::invalidateTheme(const QString &themeName)
+{
+    QMutexLocker locker(&m_mutex);
+    Q_FOREACH(const QString& key, m_images.keys()) {
+        QString keyTheme = key.section('\n', 0, 0);
+        if (themeName.isEmpty() ? !keyTheme.isEmpty() : keyTheme == themeName) {
+            m_images.remove(key);
+        }
+    }
+}
+
+bool IconImageProvider::findCachedImage(const QString &key, QImage *image)
+{
+    QMutexLocker locker(&m_mutex);
+    QImage* cached = m_images.object(key);
+    if (cached == NULL) {
+        m_missCount++;
+        return false;
+    }
+    m_hitCount++;
+    *image = *cached;
+    return true;
+}
+
+void IconImageProvider::cacheImage(const QString &key, const QImage &image)
+{
+    QMutexLocker locker(&m_mutex);
+    m_images.insert(key, new QImage(image), imageCost(image));
+}
+
+void* IconImageProvider::customTheme(const QString &themeName)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_themes.contains(themeName)) {
+        return m_themes[themeName];
+    }
+
+    GtkIconTheme* theme = gtk_icon_theme_new();
+    gtk_icon_theme_set_custom_theme(theme, themeName.toUtf8().data());
+    g_object_set_data_full(G_OBJECT(theme), "unity-2d-theme-name",
+                           g_strdup(themeName.toUtf8().data()), g_free);
+    g_signal_connect(theme, "changed", G_CALLBACK(onThemeChanged), this);
+    m_themes[themeName] = theme;
+    return theme;
+}
+
+QImage IconImageProvider::loadIconFile(const QString &iconFilePath, const QSize &requestedSize)
+{
+    QImage icon;
+    {
+        QMutexLocker locker(&m_mutex);
+        QImage* fileImage = m_fileImages.object(iconFilePath);
+        if (fileImage != NULL) {
+            icon = *fileImage;
+        }
+    }
+
+    if (icon.isNull()) {
+        icon = QImage(iconFilePath);
+        if (icon.isNull()) {
+            UQ_WARNING << "Failed to directly load icon at path:" << iconFilePath;
+            return QImage();
+        }
+        QMutexLocker locker(&m_mutex);
+        m_fileImages.insert(iconFilePath, new QImage(icon), imageCost(icon));
+    }
+
+    if (requestedSize.isValid()) {
+        icon = icon.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return icon;
+}
+
 QImage IconImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
 {
     /* Special case handling for image resources that belong to the unity
@@ -62,16 +210,22 @@ QImage IconImageProvider::requestImage(const QString &id, QSize *size, const QSi
     /* We have a direct path to the icon file. Let's load it, scale it if required and
        we are done */
     if (!iconFilePath.isEmpty()) {
-        QImage icon(iconFilePath);
-        if (icon.isNull()) {
-            UQ_WARNING << "Failed to directly load icon at path:" << iconFilePath;
-            return QImage();
+        QString key = cacheKey(QString(), iconFilePath, requestedSize);
+        QImage cached;
+        if (findCachedImage(key, &cached)) {
+            if (size) {
+                *size = cached.size();
+            }
+            return cached;
         }
 
-        if (requestedSize.isValid()) {
-            icon = icon.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        QImage icon = loadIconFile(iconFilePath, requestedSize);
+        /* Direct paths are never invalidated with a theme: do not remember
+           that a file is missing, as it may be written later on, for
+           example by the application at startup */
+        if (!icon.isNull()) {
+            cacheImage(key, icon);
         }
-
         if (size) {
             *size = icon.size();
         }
@@ -81,27 +235,35 @@ QImage IconImageProvider::requestImage(const QString &id, QSize *size, const QSi
     /* if id is of the form theme_name/icon_name then lookup the icon in the
        specified theme otherwise in the default theme */
     QString icon_name;
-    GtkIconTheme *theme;
+    QString theme_name;
 
     QStringList split_id = id.split("/");
     if(split_id.length() > 1) {
         /* use specified theme */
-        QString theme_name = split_id[0];
+        theme_name = split_id[0];
         icon_name = split_id[1];
-
-        if(m_themes.contains(theme_name)) {
-            theme = (GtkIconTheme*)m_themes[theme_name];
-        } else {
-            theme = gtk_icon_theme_new();
-            gtk_icon_theme_set_custom_theme(theme, theme_name.toUtf8().data());
-            m_themes[theme_name] = theme;
-        }
     } else {
         /* use default theme */
-        theme = gtk_icon_theme_get_default();
+        theme_name = DEFAULT_THEME_KEY;
         icon_name = id;
     }
 
+    QString key = cacheKey(theme_name, icon_name, requestedSize);
+    QImage cached;
+    if (findCachedImage(key, &cached)) {
+        if (size) {
+            *size = cached.size();
+        }
+        return cached;
+    }
+
+    GtkIconTheme *theme;
+    if (theme_name == DEFAULT_THEME_KEY) {
+        theme = gtk_icon_theme_get_default();
+    } else {
+        theme = (GtkIconTheme*)customTheme(theme_name);
+    }
+
     /* Some desktop files have a malformed Icon= key where the value contains
        not only the icon name but also an extension which makes the lookup fail.
        Solution: chop off the extension.
@@ -115,7 +277,11 @@ QImage IconImageProvider::requestImage(const QString &id, QSize *size, const QSi
         icon_name.chop(4);
     }
 
-    QImage image = GImageUtils::imageForIconString(icon_name, requestedSize.width(), theme);
+    /* Icons decoded by any unity-2d process are kept on disk */
+    QImage image = IconDiskCache::instance()->imageForIconString(
+        icon_name, requestedSize.width(), theme,
+        theme_name == DEFAULT_THEME_KEY ? QString() : theme_name);
+    cacheImage(key, image);
     if (size) {
         *size = image.size();
     }
@@ -18,8 +18,22 @@
 #define ICONIMAGEPROVIDER_H
 
 #include <QDeclarativeImageProvider>
+#include <QCache>
 #include <QHash>
+#include <QImage>
+#include <QMutex>
 
+/* Icons are kept in memory once loaded, in two least recently used caches
+   each with a budget in bytes:
+   - the icons as served, keyed by theme, icon and requested size, so that
+     views showing the same icons over and over (launcher, dash results,
+     spread) do not look them up, decode and convert them again;
+   - the icons loaded from a file path at their original size, so that
+     requesting them at another size does not read them from disk again.
+   Icons of a theme are dropped when the theme changes, for example when
+   icons get installed or the user picks another theme.
+
+   Requests can come from the threads of asynchronous Image elements. */
 class IconImageProvider : public QDeclarativeImageProvider
 {
 public:
@@ -27,7 +41,32 @@ public:
     ~IconImageProvider();
     virtual QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
 
+    /* Maximum total size of the icons kept, in bytes */
+    void setMemoryBudget(int bytes);
+    int memoryBudget() const;
+
+    /* Statistics: total size of the icons currently kept, number of
+       requests served from memory and number that required a lookup */
+    int memoryUsage() const;
+    int hitCount() const;
+    int missCount() const;
+
+    /* Drops the icons of the theme, or all the icons loaded from a theme
+       if themeName is empty */
+    void invalidateTheme(const QString &themeName);
+
 private:
+    QImage loadIconFile(const QString &iconFilePath, const QSize &requestedSize);
+    bool findCachedImage(const QString &key, QImage *image);
+    void cacheImage(const QString &key, const QImage &image);
+    void* customTheme(const QString &themeName);
+
+    mutable QMutex m_mutex;
+    QCache<QString, QImage> m_images;
+    QCache<QString, QImage> m_fileImages;
+    int m_hitCount;
+    int m_missCount;
+
     /* Cache of Gtk themes */
     /* FIXME: values are set to be of type void* in order to avoid importing
               gtk/gtk.h necessary for GtkIconTheme that would otherwise lead
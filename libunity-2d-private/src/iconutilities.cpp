@@ -22,14 +22,208 @@
 // libunity-2d
 #include <debug_p.h>
 
+// GTK
+#include <gtk/gtk.h>
+
 // Qt
 #include <QImage>
 #include <QDeclarativeEngine>
 #include <QDeclarativeContext>
 #include <QDeclarativeImageProvider>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* The relevance of a pixel is .1 + .9 * alpha * saturation, alpha and
+   saturation being in [0, 1]. It is computed in fixed point as
+   weight / WEIGHT_SCALE, where weight = 65025 + 9 * alpha * saturation with
+   alpha and saturation in [0, 255]. Integer arithmetic makes the result
+   independent of the order in which pixels are summed, so that the SIMD
+   kernels give exactly the same result as the scalar one. */
+static const quint32 WEIGHT_BASE = 255 * 255;
+static const quint32 WEIGHT_SCALE = 10 * 255 * 255;
+
+/* x / WEIGHT_SCALE == (x * RECIPROCAL) >> RECIPROCAL_SHIFT for all the
+   values of x = channel * weight, that is x <= 255 * WEIGHT_SCALE. This was
+   checked exhaustively. */
+static const quint32 RECIPROCAL = 432871937;
+static const int RECIPROCAL_SHIFT = 48;
+
+struct ColorTotals
+{
+    ColorTotals() : red(0), green(0), blue(0), weight(0) {}
+
+    quint64 red;
+    quint64 green;
+    quint64 blue;
+    /* Sum of the weights, that is 255 * WEIGHT_SCALE times the relevances */
+    quint64 weight;
+};
+
+static inline void accumulatePixel(QRgb pixel, ColorTotals* totals)
+{
+    int red = qRed(pixel);
+    int green = qGreen(pixel);
+    int blue = qBlue(pixel);
+    int saturation = qMax(red, qMax(green, blue)) - qMin(red, qMin(green, blue));
+    quint32 weight = WEIGHT_BASE + 9 * qAlpha(pixel) * saturation;
+
+    totals->red += red * weight / WEIGHT_SCALE;
+    totals->green += green * weight / WEIGHT_SCALE;
+    totals->blue += blue * weight / WEIGHT_SCALE;
+    totals->weight += weight;
+}
+
+static void accumulateLineScalar(const QRgb* line, int count, ColorTotals* totals)
+{
+    for (int x = 0; x < count; x++) {
+        accumulatePixel(line[x], totals);
+    }
+}
+
+#if defined(__SSE2__)
+/* Low 32 bits of the products of the 4 lanes */
+static inline __m128i multiply(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i divideByWeightScale(__m128i x)
+{
+    const __m128i reciprocal = _mm_set1_epi32(RECIPROCAL);
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(x, reciprocal), RECIPROCAL_SHIFT);
+    __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_si128(x, 4), reciprocal),
+                                 RECIPROCAL_SHIFT);
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline quint32 sumLanes(__m128i x)
+{
+    x = _mm_add_epi32(x, _mm_srli_si128(x, 8));
+    x = _mm_add_epi32(x, _mm_srli_si128(x, 4));
+    return _mm_cvtsi128_si32(x);
+}
+
+static void accumulateLineSimd(const QRgb* line, int count, ColorTotals* totals)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i weightBase = _mm_set1_epi32(WEIGHT_BASE);
+    __m128i red = _mm_setzero_si128();
+    __m128i green = _mm_setzero_si128();
+    __m128i blue = _mm_setzero_si128();
+    /* Fits in 32 bits for lines of up to 26000 pixels */
+    __m128i weight = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+        __m128i b = _mm_and_si128(pixels, mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+        __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+        __m128i a = _mm_srli_epi32(pixels, 24);
+
+        /* All the values fit in the low 16 bits of the lanes */
+        __m128i saturation = _mm_sub_epi16(_mm_max_epi16(r, _mm_max_epi16(g, b)),
+                                           _mm_min_epi16(r, _mm_min_epi16(g, b)));
+        __m128i alphaSaturation = _mm_mullo_epi16(a, saturation);
+        __m128i w = _mm_add_epi32(weightBase, _mm_add_epi32(_mm_slli_epi32(alphaSaturation, 3),
+                                                            alphaSaturation));
+
+        red = _mm_add_epi32(red, divideByWeightScale(multiply(r, w)));
+        green = _mm_add_epi32(green, divideByWeightScale(multiply(g, w)));
+        blue = _mm_add_epi32(blue, divideByWeightScale(multiply(b, w)));
+        weight = _mm_add_epi32(weight, w);
+    }
+
+    totals->red += sumLanes(red);
+    totals->green += sumLanes(green);
+    totals->blue += sumLanes(blue);
+    totals->weight += sumLanes(weight);
+    accumulateLineScalar(line + x, count - x, totals);
+}
+#elif defined(__ARM_NEON__)
+static inline uint32x4_t divideByWeightScale(uint32x4_t x)
+{
+    const uint32x2_t reciprocal = vdup_n_u32(RECIPROCAL);
+    uint64x2_t low = vshrq_n_u64(vmull_u32(vget_low_u32(x), reciprocal), RECIPROCAL_SHIFT);
+    uint64x2_t high = vshrq_n_u64(vmull_u32(vget_high_u32(x), reciprocal), RECIPROCAL_SHIFT);
+    return vcombine_u32(vmovn_u64(low), vmovn_u64(high));
+}
+
+static inline quint32 sumLanes(uint32x4_t x)
+{
+    return vgetq_lane_u32(x, 0) + vgetq_lane_u32(x, 1)
+           + vgetq_lane_u32(x, 2) + vgetq_lane_u32(x, 3);
+}
+
+static void accumulateLineSimd(const QRgb* line, int count, ColorTotals* totals)
+{
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+    const uint32x4_t weightBase = vdupq_n_u32(WEIGHT_BASE);
+    uint32x4_t red = vdupq_n_u32(0);
+    uint32x4_t green = vdupq_n_u32(0);
+    uint32x4_t blue = vdupq_n_u32(0);
+    uint64x2_t weight = vdupq_n_u64(0);
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        uint32x4_t pixels = vld1q_u32(reinterpret_cast<const uint32_t*>(line + x));
+        uint32x4_t b = vandq_u32(pixels, mask);
+        uint32x4_t g = vandq_u32(vshrq_n_u32(pixels, 8), mask);
+        uint32x4_t r = vandq_u32(vshrq_n_u32(pixels, 16), mask);
+        uint32x4_t a = vshrq_n_u32(pixels, 24);
+
+        uint32x4_t saturation = vsubq_u32(vmaxq_u32(r, vmaxq_u32(g, b)),
+                                          vminq_u32(r, vminq_u32(g, b)));
+        uint32x4_t w = vmlaq_n_u32(weightBase, vmulq_u32(a, saturation), 9);
+
+        red = vaddq_u32(red, divideByWeightScale(vmulq_u32(r, w)));
+        green = vaddq_u32(green, divideByWeightScale(vmulq_u32(g, w)));
+        blue = vaddq_u32(blue, divideByWeightScale(vmulq_u32(b, w)));
+        weight = vpadalq_u32(weight, w);
+    }
+
+    totals->red += sumLanes(red);
+    totals->green += sumLanes(green);
+    totals->blue += sumLanes(blue);
+    totals->weight += vgetq_lane_u64(weight, 0) + vgetq_lane_u64(weight, 1);
+    accumulateLineScalar(line + x, count - x, totals);
+}
+#else
+static void accumulateLineSimd(const QRgb* line, int count, ColorTotals* totals)
+{
+    accumulateLineScalar(line, count, totals);
+}
+#endif
+
+static void onIconThemeChanged(GtkIconTheme* theme, gpointer data)
+{
+    Q_UNUSED(theme)
+    static_cast<IconUtilities*>(data)->clearCache();
+}
+
 IconUtilities::IconUtilities(QDeclarativeEngine *engine) : QObject(engine), m_engine(engine)
 {
+    g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                     G_CALLBACK(onIconThemeChanged), this);
+}
+
+IconUtilities::~IconUtilities()
+{
+    g_signal_handlers_disconnect_by_func(gtk_icon_theme_get_default(),
+                                         (gpointer)onIconThemeChanged, this);
+}
+
+void IconUtilities::clearCache()
+{
+    m_colors.clear();
 }
 
 /* Calculates both the background color and the glow color of a launcher tile
@@ -40,35 +234,49 @@ IconUtilities::IconUtilities(QDeclarativeEngine *engine) : QObject(engine), m_en
 QList<QVariant>
 IconUtilities::getColorsFromIcon(QUrl source, QSize size) const
 {
-    QList<QVariant> colors;
+    QString key = QString("%1@%2x%3").arg(source.toString()).arg(size.width()).arg(size.height());
+    QHash<QString, QList<QVariant> >::const_iterator cached = m_colors.constFind(key);
+    if (cached != m_colors.constEnd()) {
+        return cached.value();
+    }
 
-    // FIXME: we should find a way to avoid reloading the icon
+    /* The icon was just loaded for the tile, so it is served from the
+       memory cache of the image provider */
     QImage icon = m_engine->imageProvider("icons")->requestImage(source.path().mid(1), &size, size);
     if (icon.width() == 0 || icon.height() == 0) {
         UQ_WARNING << "Unable to load icon in getColorsFromIcon from" << source;
-        return colors;
+        return QList<QVariant>();
     }
 
-    long int rtotal = 0, gtotal = 0, btotal = 0;
-    float total = 0.0f;
-
-    for (int y = 0; y < icon.height(); ++y) {
-        for (int x = 0; x < icon.width(); ++x) {
-            QColor color = QColor::fromRgba(icon.pixel(x, y));
+    QList<QVariant> colors = colorsFromImage(icon);
+    m_colors.insert(key, colors);
+    return colors;
+}
 
-            float saturation = (qMax (color.red(), qMax (color.green(), color.blue())) -
-                                qMin (color.red(), qMin (color.green(), color.blue()))) / 255.0f;
-            float relevance = .1 + .9 * (color.alpha() / 255.0f) * saturation;
+QList<QVariant>
+IconUtilities::colorsFromImage(const QImage& icon, bool allowSimd)
+{
+    QList<QVariant> colors;
+    if (icon.isNull()) {
+        return colors;
+    }
 
-            rtotal += (unsigned char) (color.red() * relevance);
-            gtotal += (unsigned char) (color.green() * relevance);
-            btotal += (unsigned char) (color.blue() * relevance);
+    /* Work on unpremultiplied pixels, as QImage::pixel() returns */
+    QImage image = icon.convertToFormat(QImage::Format_ARGB32);
 
-            total += relevance * 255;
+    ColorTotals totals;
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        if (allowSimd) {
+            accumulateLineSimd(line, image.width(), &totals);
+        } else {
+            accumulateLineScalar(line, image.width(), &totals);
         }
     }
 
-    QColor hsv = QColor::fromRgbF(rtotal / total, gtotal / total, btotal / total).toHsv();
+    qreal total = qreal(totals.weight) / (WEIGHT_SCALE / 255);
+    QColor hsv = QColor::fromRgbF(totals.red / total, totals.green / total,
+                                  totals.blue / total).toHsv();
 
     /* Background color is the base color with 0.90f HSV value */
     hsv.setHsvF(hsv.hueF(),
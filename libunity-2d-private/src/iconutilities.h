@@ -18,22 +18,37 @@
 #define ICONUTILITIES_H
 
 #include <QObject>
+#include <QHash>
 #include <QUrl>
 #include <QSize>
 #include <QVariant>
 #include <QDeclarativeEngine>
 
+class QImage;
+
 class IconUtilities : public QObject
 {
     Q_OBJECT
 
 public :
     explicit IconUtilities(QDeclarativeEngine *engine);
+    ~IconUtilities();
 
+    /* The colors are computed once per icon and size, until the icon
+       theme changes */
     Q_INVOKABLE QList<QVariant> getColorsFromIcon(QUrl source, QSize size) const;
 
+    /* Computes the colors of a launcher tile from the pixels of icon.
+       The SIMD kernel is used if available unless allowSimd is false, both
+       kernels give exactly the same results. */
+    static QList<QVariant> colorsFromImage(const QImage& icon, bool allowSimd = true);
+
+    /* Forgets the colors computed so far */
+    void clearCache();
+
 private:
     QDeclarativeEngine* m_engine;
+    mutable QHash<QString, QList<QVariant> > m_colors;
 };
 
 #endif // ICONUTILITIES_H
@@ -25,7 +25,7 @@
 #include <cairoutils.h>
 #include <debug_p.h>
 #include <gscopedpointer.h>
-#include <gimageutils.h>
+#include <icondiskcache.h>
 #include <panelstyle.h>
 
 // Qt
@@ -293,11 +293,18 @@ QPixmap IndicatorEntryWidget::decodeIcon()
         }
     } else if (type == GTK_IMAGE_ICON_NAME) {
         QString name = QString::fromStdString(m_entry->image_data());
-        QIcon icon = QIcon::fromTheme(name);
-        pix = icon.pixmap(ICON_SIZE, ICON_SIZE);
+        /* Served decoded from the cache shared with the other unity-2d
+           processes, if possible */
+        QImage image = IconDiskCache::instance()->imageForIconString(name, ICON_SIZE);
+        if (!image.isNull()) {
+            pix = QPixmap::fromImage(image);
+        } else {
+            QIcon icon = QIcon::fromTheme(name);
+            pix = icon.pixmap(ICON_SIZE, ICON_SIZE);
+        }
     } else if (type == GTK_IMAGE_GICON) {
         QString name = QString::fromStdString(m_entry->image_data());
-        QImage image = GImageUtils::imageForIconString(name, ICON_SIZE);
+        QImage image = IconDiskCache::instance()->imageForIconString(name, ICON_SIZE);
         if (image.isNull()) {
             UQ_WARNING << "Failed to load icon from" << name;
             return QPixmap();
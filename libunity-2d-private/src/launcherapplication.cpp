@@ -36,6 +36,9 @@
 #include "launcherapplication.h"
 #include "launchermenu.h"
 #include "launcherutility.h"
+#include "desktopentryindex.h"
+#include "desktopfilewatcher.h"
+#include "windowworkspaceindex.h"
 #include "bamf-matcher.h"
 #include "bamf-indicator.h"
 
@@ -55,7 +58,6 @@
 #include <QDBusReply>
 #include <QDBusServiceWatcher>
 #include <QFile>
-#include <QFileSystemWatcher>
 #include <QScopedPointer>
 #include <QX11Info>
 
@@ -67,20 +69,48 @@ extern "C" {
 
 const char* SHORTCUT_NICK_PROPERTY = "nick";
 
+/* Time the tooltip of an application has to be shown before its menu is
+   fetched, so that it is ready when unfolded but not fetched for every
+   item the pointer merely crosses */
+static const int MENU_PREFETCH_DELAY = 150;
+/* Time after which the menu importers of an application are released when
+   its menu was not shown */
+static const int MENU_EVICTION_DELAY = 5 * 60 * 1000;
+
+/* Overlay updates, e.g. progress sent by a download manager many times
+   a second, are applied at most once per frame */
+static const int OVERLAYS_UPDATE_INTERVAL = 1000 / 60;
+
+static int sMenuImporterCount = 0;
+static int sMenuRequestsAvoided = 0;
+
 LauncherApplication::LauncherApplication()
     : m_application(NULL)
-    , m_desktopFileWatcher(NULL)
     , m_sticky(false)
     , m_has_visible_window(false)
+    , m_indicatorMenusRequested(false)
+    , m_indicatorMenusReady(0)
     , m_progress(0), m_progressBarVisible(false)
     , m_counter(0), m_counterVisible(false)
     , m_emblem(QString()), m_emblemVisible(false)
+    , m_overlayUpdatesDropped(0)
     , m_forceUrgent(false)
     , m_dynamicQuicklistServiceWatcher(NULL)
 {
     m_launching_timer.setSingleShot(true);
     m_launching_timer.setInterval(8000);
     QObject::connect(&m_launching_timer, SIGNAL(timeout()), this, SLOT(onLaunchingTimeouted()));
+
+    m_menuPrefetchTimer.setSingleShot(true);
+    m_menuPrefetchTimer.setInterval(MENU_PREFETCH_DELAY);
+    connect(&m_menuPrefetchTimer, SIGNAL(timeout()), SLOT(prefetchMenus()));
+    m_menuEvictionTimer.setSingleShot(true);
+    m_menuEvictionTimer.setInterval(MENU_EVICTION_DELAY);
+    connect(&m_menuEvictionTimer, SIGNAL(timeout()), SLOT(evictMenuImporters()));
+    connect(m_menu, SIGNAL(visibleChanged(bool)), SLOT(onMenuVisibleChanged(bool)));
+    m_overlaysUpdateTimer.setSingleShot(true);
+    m_overlaysUpdateTimer.setInterval(OVERLAYS_UPDATE_INTERVAL);
+    connect(&m_overlaysUpdateTimer, SIGNAL(timeout()), SLOT(applyOverlaysState()));
 }
 
 LauncherApplication::LauncherApplication(const LauncherApplication& other)
@@ -94,6 +124,12 @@ LauncherApplication::LauncherApplication(const LauncherApplication& other)
 
 LauncherApplication::~LauncherApplication()
 {
+    DesktopFileWatcher::instance()->unwatch(m_monitoredDesktopFile, this);
+    clearWindowWorkspaces();
+    deleteMenuImporters();
+    if (!m_dynamicQuicklistImporter.isNull()) {
+        sMenuImporterCount--;
+    }
 }
 
 bool
@@ -187,6 +223,10 @@ LauncherApplication::name() const
         return QString::fromUtf8(sn_startup_sequence_get_name(m_snStartupSequence.data()));
     }
 
+    if (!m_snapshotDesktopFile.isEmpty()) {
+        return m_snapshotName;
+    }
+
     return QString("");
 }
 
@@ -211,6 +251,10 @@ LauncherApplication::icon() const
         return QString::fromUtf8(sn_startup_sequence_get_icon_name(m_snStartupSequence.data()));
     }
 
+    if (!m_snapshotDesktopFile.isEmpty()) {
+        return m_snapshotIcon;
+    }
+
     return QString("");
 }
 
@@ -235,7 +279,7 @@ LauncherApplication::desktop_file() const
         return QString::fromUtf8(g_desktop_app_info_get_filename((GDesktopAppInfo*)m_appInfo.data()));
     }
 
-    return QString("");
+    return m_snapshotDesktopFile;
 }
 
 QString
@@ -263,19 +307,59 @@ LauncherApplication::setSticky(bool sticky)
     stickyChanged(sticky);
 }
 
+void
+LauncherApplication::setDesktopFileSnapshot(const QString& desktop_file, const QString& name,
+                                            const QString& icon)
+{
+    m_snapshotDesktopFile = desktop_file;
+    m_snapshotName = name;
+    m_snapshotIcon = icon;
+    Q_EMIT desktopFileChanged(desktop_file);
+    Q_EMIT nameChanged(name);
+    Q_EMIT iconChanged(icon);
+}
+
+bool
+LauncherApplication::hydrated() const
+{
+    return m_snapshotDesktopFile.isEmpty();
+}
+
+void
+LauncherApplication::hydrate()
+{
+    if (hydrated()) {
+        return;
+    }
+
+    setDesktopFile(m_snapshotDesktopFile);
+}
+
 void
 LauncherApplication::setDesktopFile(const QString& desktop_file)
 {
     QString oldDesktopFile = this->desktop_file();
+    /* A snapshot is only used until the desktop file is read */
+    m_snapshotDesktopFile.clear();
 
     QByteArray byte_array = desktop_file.toUtf8();
     gchar *file = byte_array.data();
 
+    /* Desktop file ids are resolved by the index of the installed desktop
+       files, without GIO looking for them in all the data directories */
+    QString indexedFile;
+    if (!desktop_file.startsWith("/")) {
+        indexedFile = DesktopEntryIndex::instance()->fileForId(desktop_file);
+    }
+
     if(desktop_file.startsWith("/")) {
         /* It looks like a full path to a desktop file */
         m_appInfo.reset((GAppInfo*)g_desktop_app_info_new_from_filename(file));
+    } else if (!indexedFile.isEmpty()) {
+        m_appInfo.reset((GAppInfo*)g_desktop_app_info_new_from_filename(indexedFile.toUtf8().constData()));
     } else {
-        /* It might just be a desktop file name; let GIO look for the actual
+        /* It might just be the name of a desktop file installed so recently
+           that the index does not know it yet; let GIO look for the actual
            desktop file for us */
         /* The docs for g_desktop_app_info_new() says it respects "-" to "/"
            substitution as per XDG Menu Spec, but it only seems to work for
@@ -317,9 +401,9 @@ LauncherApplication::setDesktopFile(const QString& desktop_file)
         Q_EMIT executableChanged(executable());
     }
 
-    /* Update the list of static shortcuts
-       (quicklist entries defined in the desktop file). */
-    m_staticShortcuts.reset(indicator_desktop_shortcuts_new(newDesktopFile.toUtf8().constData(), "Unity"));
+    /* The list of static shortcuts (quicklist entries defined in the
+       desktop file) is read again when the menu is next shown. */
+    m_staticShortcuts.reset();
 
     monitorDesktopFile(newDesktopFile);
 }
@@ -328,35 +412,28 @@ void
 LauncherApplication::monitorDesktopFile(const QString& path)
 {
     /* Monitor the desktop file for live changes */
-    if (m_desktopFileWatcher == NULL) {
-        /* FIXME: deleting a QFileSystemWatcher can be quite slow (sometimes
-           around 100ms on a powerful computer) and can provoke visual glitches
-           where the user interface is blocked for a short moment.
-         */
-        m_desktopFileWatcher = new QFileSystemWatcher(this);
-        connect(m_desktopFileWatcher, SIGNAL(fileChanged(const QString&)),
-                SLOT(onDesktopFileChanged(const QString&)));
-    }
-
-    /* If the file is already being monitored, we shouldn’t need to do anything.
-       However it seems that in some cases, a change to the file will stop
-       emiting further fileChanged signals, despite the file still being in the
-       list of monitored files. This is the case when the desktop file is being
-       edited in gedit for example. This may be a bug in QT itself.
-       To work around this issue, remove the path and add it again. */
-    if (m_desktopFileWatcher->files().contains(path)) {
-        m_desktopFileWatcher->removePath(path);
+    DesktopFileWatcher* watcher = DesktopFileWatcher::instance();
+    if (path == m_monitoredDesktopFile) {
+        /* Editors that save to a temporary file and move it in place of the
+           desktop file replace it with a new one that needs to be watched */
+        watcher->refresh(path);
+        return;
     }
 
-    if (!path.isEmpty()) {
-        m_desktopFileWatcher->addPath(path);
-    }
+    watcher->unwatch(m_monitoredDesktopFile, this);
+    m_monitoredDesktopFile = path;
+    /* Only the changes of that file are delivered */
+    watcher->watch(m_monitoredDesktopFile, this, "onDesktopFileChanged");
 }
 
 void
 LauncherApplication::onDesktopFileChanged(const QString& path)
 {
-    if (m_desktopFileWatcher->files().contains(path) || QFile::exists(path)) {
+    if (path != m_monitoredDesktopFile) {
+        return;
+    }
+
+    if (QFile::exists(path)) {
         /* The contents of the file have changed. */
         setDesktopFile(path);
     } else {
@@ -425,6 +502,7 @@ LauncherApplication::setBamfApplication(BamfApplication *application)
     connect(application, SIGNAL(ChildRemoved(BamfView*)), SLOT(slotChildRemoved(BamfView*)));
 
     connect(application, SIGNAL(WindowAdded(BamfWindow*)), SLOT(onWindowAdded(BamfWindow*)));
+    connect(application, SIGNAL(WindowRemoved(BamfWindow*)), SLOT(onWindowRemoved(BamfWindow*)));
 
     updateBamfApplicationDependentProperties();
     updateCounterVisible();
@@ -444,6 +522,7 @@ LauncherApplication::updateBamfApplicationDependentProperties()
     launchingChanged(launching());
     updateHasVisibleWindow();
     updateWindowCount();
+    updateWindowWorkspaces();
     fetchIndicatorMenus();
 }
 
@@ -513,10 +592,85 @@ void
 LauncherApplication::onWindowAdded(BamfWindow* window)
 {
     if (window != NULL) {
+        setWindowWorkspace(window->xid(), WindowWorkspaceIndex::instance()->workspace(window->xid()));
         windowAdded(window->xid());
     }
 }
 
+void
+LauncherApplication::onWindowRemoved(BamfWindow* window)
+{
+    if (window == NULL) {
+        return;
+    }
+
+    QHash<unsigned int, int>::iterator it = m_windowWorkspaces.find(window->xid());
+    if (it != m_windowWorkspaces.end()) {
+        if (--m_windowCountByWorkspace[it.value()] == 0) {
+            m_windowCountByWorkspace.remove(it.value());
+        }
+        m_windowWorkspaces.erase(it);
+        WindowWorkspaceIndex::instance()->unwatch(window->xid(), this);
+    }
+}
+
+void
+LauncherApplication::onWindowWorkspaceChanged(unsigned int xid, int previousWorkspace, int workspace)
+{
+    Q_UNUSED(previousWorkspace);
+
+    if (m_windowWorkspaces.contains(xid)) {
+        setWindowWorkspace(xid, workspace);
+    }
+}
+
+void
+LauncherApplication::setWindowWorkspace(unsigned int xid, int workspace)
+{
+    QHash<unsigned int, int>::iterator it = m_windowWorkspaces.find(xid);
+    if (it != m_windowWorkspaces.end()) {
+        if (it.value() == workspace) {
+            return;
+        }
+        if (--m_windowCountByWorkspace[it.value()] == 0) {
+            m_windowCountByWorkspace.remove(it.value());
+        }
+        it.value() = workspace;
+    } else {
+        m_windowWorkspaces.insert(xid, workspace);
+        /* Only the changes of the windows of the application are delivered */
+        WindowWorkspaceIndex::instance()->watch(xid, this, "onWindowWorkspaceChanged");
+    }
+    m_windowCountByWorkspace[workspace]++;
+}
+
+void
+LauncherApplication::clearWindowWorkspaces()
+{
+    WindowWorkspaceIndex* index = WindowWorkspaceIndex::instance();
+    QHash<unsigned int, int>::const_iterator it;
+    for (it = m_windowWorkspaces.constBegin(); it != m_windowWorkspaces.constEnd(); ++it) {
+        index->unwatch(it.key(), this);
+    }
+    m_windowWorkspaces.clear();
+    m_windowCountByWorkspace.clear();
+}
+
+void
+LauncherApplication::updateWindowWorkspaces()
+{
+    clearWindowWorkspaces();
+    if (m_application == NULL) {
+        return;
+    }
+
+    WindowWorkspaceIndex* index = WindowWorkspaceIndex::instance();
+    QScopedPointer<BamfUintList> xids(m_application->xids());
+    for (int i = 0; i < xids->size(); i++) {
+        setWindowWorkspace(xids->at(i), index->workspace(xids->at(i)));
+    }
+}
+
 bool
 LauncherApplication::launching() const
 {
@@ -599,37 +753,15 @@ LauncherApplication::emblemVisible() const
 }
 
 /* Returns the number of window for this application that reside on the
-   current workspace */
+   current workspace. Windows wnck does not know about yet are not counted. */
 int
 LauncherApplication::windowCountOnCurrentWorkspace()
 {
-    int windowCount = 0;
-    WnckWorkspace *current = wnck_screen_get_active_workspace(wnck_screen_get_default());
-
-    for (int i = 0; i < m_application->windows()->size(); i++) {
-        BamfWindow *window = m_application->windows()->at(i);
-        if (window == NULL) {
-            continue;
-        }
-
-        /* When geting the wnck window, it's possible we get a NULL
-           return value because wnck hasn't updated its internal list yet,
-           so we need to force it once to be sure */
-        WnckWindow *wnck_window = wnck_window_get(window->xid());
-        if (wnck_window == NULL) {
-            wnck_screen_force_update(wnck_screen_get_default());
-            wnck_window = wnck_window_get(window->xid());
-            if (wnck_window == NULL) {
-                continue;
-            }
-        }
-
-        WnckWorkspace *workspace = wnck_window_get_workspace(wnck_window);
-        if (workspace == current) {
-            windowCount++;
-        }
+    int current = WindowWorkspaceIndex::instance()->activeWorkspace();
+    if (current == WindowWorkspaceIndex::NO_WORKSPACE) {
+        return 0;
     }
-    return windowCount;
+    return m_windowCountByWorkspace.value(current);
 }
 
 void
@@ -661,6 +793,7 @@ LauncherApplication::launchNewInstance()
 bool
 LauncherApplication::launch()
 {
+    hydrate();
     if (m_appInfo == NULL) {
         return false;
     }
@@ -805,11 +938,9 @@ LauncherApplication::slotChildAdded(BamfView* child)
 {
     BamfIndicator* indicator = qobject_cast<BamfIndicator*>(child);
     if (indicator != NULL) {
-        QString path = indicator->dbus_menu_path();
-        if (!m_indicatorMenus.contains(path)) {
-            DBusMenuImporter* importer = new DBusMenuImporter(indicator->address(), path, this);
-            connect(importer, SIGNAL(menuUpdated()), SLOT(onIndicatorMenuUpdated()));
-            m_indicatorMenus[path] = importer;
+        m_indicatorMenuServices.insert(indicator->dbus_menu_path(), indicator->address());
+        if (m_menu->isVisible()) {
+            createMenuImporters();
         }
     }
 }
@@ -820,8 +951,13 @@ LauncherApplication::slotChildRemoved(BamfView* child)
     BamfIndicator* indicator = qobject_cast<BamfIndicator*>(child);
     if (indicator != NULL) {
         QString path = indicator->dbus_menu_path();
-        if (m_indicatorMenus.contains(path)) {
-            m_indicatorMenus.take(path)->deleteLater();
+        m_indicatorMenuServices.remove(path);
+        DBusMenuImporter* importer = m_indicatorMenus.take(path);
+        if (importer != NULL) {
+            m_pendingIndicatorMenus.remove(importer);
+            m_updatedIndicatorMenus.remove(importer);
+            importer->deleteLater();
+            sMenuImporterCount--;
         }
     }
 }
@@ -829,9 +965,14 @@ LauncherApplication::slotChildRemoved(BamfView* child)
 void
 LauncherApplication::fetchIndicatorMenus()
 {
-    Q_FOREACH(QString path, m_indicatorMenus.keys()) {
-        m_indicatorMenus.take(path)->deleteLater();
+    Q_FOREACH(DBusMenuImporter* importer, m_indicatorMenus) {
+        importer->deleteLater();
+        sMenuImporterCount--;
     }
+    m_indicatorMenus.clear();
+    m_pendingIndicatorMenus.clear();
+    m_updatedIndicatorMenus.clear();
+    m_indicatorMenuServices.clear();
 
     if (m_application != NULL) {
         QScopedPointer<BamfViewList> children(m_application->children());
@@ -841,18 +982,117 @@ LauncherApplication::fetchIndicatorMenus()
     }
 }
 
+void
+LauncherApplication::createMenuImporters()
+{
+    QHash<QString, QString>::const_iterator it;
+    for (it = m_indicatorMenuServices.constBegin(); it != m_indicatorMenuServices.constEnd(); ++it) {
+        if (!m_indicatorMenus.contains(it.key())) {
+            DBusMenuImporter* importer = new DBusMenuImporter(it.value(), it.key(), this);
+            connect(importer, SIGNAL(menuUpdated()), SLOT(onIndicatorMenuUpdated()));
+            m_indicatorMenus[it.key()] = importer;
+            sMenuImporterCount++;
+        }
+    }
+}
+
+void
+LauncherApplication::deleteMenuImporters()
+{
+    Q_FOREACH(DBusMenuImporter* importer, m_indicatorMenus) {
+        importer->deleteLater();
+        sMenuImporterCount--;
+    }
+    m_indicatorMenus.clear();
+    m_pendingIndicatorMenus.clear();
+    m_updatedIndicatorMenus.clear();
+}
+
+void
+LauncherApplication::onMenuVisibleChanged(bool visible)
+{
+    if (visible) {
+        m_menuEvictionTimer.stop();
+        m_menuPrefetchTimer.start();
+    } else {
+        m_menuPrefetchTimer.stop();
+        m_indicatorMenusRequested = false;
+        /* The menus are fetched again the next time they are shown */
+        m_updatedIndicatorMenus.clear();
+        if (!m_indicatorMenus.isEmpty()) {
+            m_menuEvictionTimer.start();
+        }
+    }
+}
+
+void
+LauncherApplication::prefetchMenus()
+{
+    hydrate();
+    staticShortcuts();
+    createMenuImporters();
+    if (m_application == NULL) {
+        return;
+    }
+    Q_FOREACH(DBusMenuImporter* importer, m_indicatorMenus) {
+        if (!m_pendingIndicatorMenus.contains(importer) && !m_updatedIndicatorMenus.contains(importer)) {
+            m_pendingIndicatorMenus.insert(importer);
+            importer->updateMenu();
+        }
+    }
+}
+
+void
+LauncherApplication::evictMenuImporters()
+{
+    if (m_menu->isVisible()) {
+        return;
+    }
+
+    deleteMenuImporters();
+    m_staticShortcuts.reset();
+    UQ_DEBUG << "Menu importers of" << name() << "released," << sMenuImporterCount
+             << "left for all applications," << sMenuRequestsAvoided << "menu requests avoided";
+}
+
+int
+LauncherApplication::menuImporterCount()
+{
+    return sMenuImporterCount;
+}
+
+int
+LauncherApplication::menuRequestsAvoided()
+{
+    return sMenuRequestsAvoided;
+}
+
 void
 LauncherApplication::createMenuActions()
 {
+    hydrate();
+    m_menuPrefetchTimer.stop();
+    createMenuImporters();
     if (m_application != NULL && !m_indicatorMenus.isEmpty()) {
         /* Request indicator menus to be updated: this is asynchronous
            and the corresponding actions are added to the menu in
            SLOT(onIndicatorMenuUpdated()).
+           Menus prefetched while the tooltip was shown are added right
+           away, and the ones still being fetched are not requested again.
            Static menu actions are appended after all indicator menus
            have been updated.*/
         m_indicatorMenusReady = 0;
-        Q_FOREACH(DBusMenuImporter* importer, m_indicatorMenus) {
-            importer->updateMenu();
+        m_indicatorMenusRequested = true;
+        Q_FOREACH(DBusMenuImporter* importer, m_indicatorMenus.values()) {
+            if (m_updatedIndicatorMenus.contains(importer)) {
+                sMenuRequestsAvoided++;
+                insertIndicatorMenuActions(importer);
+            } else if (m_pendingIndicatorMenus.contains(importer)) {
+                sMenuRequestsAvoided++;
+            } else {
+                m_pendingIndicatorMenus.insert(importer);
+                importer->updateMenu();
+            }
         }
     } else {
         createDynamicMenuActions();
@@ -884,7 +1124,7 @@ void
 LauncherApplication::createStaticMenuActions()
 {
     /* Custom menu actions from the desktop file. */
-    if (!m_staticShortcuts.isNull()) {
+    if (staticShortcuts() != NULL) {
         const gchar** nicks = indicator_desktop_shortcuts_get_nicks(m_staticShortcuts.data());
         if (nicks) {
             int i = 0;
@@ -948,11 +1188,21 @@ LauncherApplication::createStaticMenuActions()
 void
 LauncherApplication::onIndicatorMenuUpdated()
 {
-    if (!m_menu->isVisible()) {
+    DBusMenuImporter* importer = static_cast<DBusMenuImporter*>(sender());
+    m_pendingIndicatorMenus.remove(importer);
+    if (!m_indicatorMenusRequested || !m_menu->isVisible()) {
+        /* Prefetched: the actions are added when the menu is unfolded */
+        m_updatedIndicatorMenus.insert(importer);
         return;
     }
 
-    DBusMenuImporter* importer = static_cast<DBusMenuImporter*>(sender());
+    m_updatedIndicatorMenus.insert(importer);
+    insertIndicatorMenuActions(importer);
+}
+
+void
+LauncherApplication::insertIndicatorMenuActions(DBusMenuImporter* importer)
+{
     QList<QAction*> actions = importer->menu()->actions();
     Q_FOREACH(QAction* action, actions) {
         if (action->isSeparator()) {
@@ -965,6 +1215,7 @@ LauncherApplication::onIndicatorMenuUpdated()
 
     if (++m_indicatorMenusReady == m_indicatorMenus.size()) {
         /* All indicator menus have been updated. */
+        m_indicatorMenusRequested = false;
         createDynamicMenuActions();
         createStaticMenuActions();
     }
@@ -976,7 +1227,20 @@ LauncherApplication::onStaticShortcutTriggered()
     QAction* action = static_cast<QAction*>(sender());
     QString nick = action->property(SHORTCUT_NICK_PROPERTY).toString();
     m_menu->hide();
-    indicator_desktop_shortcuts_nick_exec(m_staticShortcuts.data(), nick.toUtf8().constData());
+    if (staticShortcuts() != NULL) {
+        indicator_desktop_shortcuts_nick_exec(m_staticShortcuts.data(), nick.toUtf8().constData());
+    }
+}
+
+IndicatorDesktopShortcuts*
+LauncherApplication::staticShortcuts()
+{
+    /* Parsing the desktop file for its shortcuts is deferred until they
+       are needed: most applications never have their menu opened */
+    if (m_staticShortcuts.isNull() && !desktop_file().isEmpty()) {
+        m_staticShortcuts.reset(indicator_desktop_shortcuts_new(desktop_file().toUtf8().constData(), "Unity"));
+    }
+    return m_staticShortcuts.data();
 }
 
 void
@@ -1012,6 +1276,35 @@ bool LauncherApplication::updateOverlayState(QMap<QString, QVariant> properties,
 void
 LauncherApplication::updateOverlaysState(const QString& sender, QMap<QString, QVariant> properties)
 {
+    if (m_overlaysUpdateTimer.isActive()) {
+        m_overlayUpdatesDropped++;
+    } else {
+        m_overlaysUpdateTimer.start();
+    }
+
+    QMap<QString, QVariant>::const_iterator it;
+    for (it = properties.constBegin(); it != properties.constEnd(); ++it) {
+        m_pendingOverlays.insert(it.key(), it.value());
+    }
+    /* The dynamic quicklist is imported from the sender that set it */
+    if (properties.contains("quicklist")) {
+        m_pendingOverlaysSender = sender;
+    }
+}
+
+int
+LauncherApplication::overlayUpdatesDropped() const
+{
+    return m_overlayUpdatesDropped;
+}
+
+void
+LauncherApplication::applyOverlaysState()
+{
+    QMap<QString, QVariant> properties = m_pendingOverlays;
+    m_pendingOverlays.clear();
+
+    /* Properties back to their value of the previous frame emit nothing */
     if (updateOverlayState(properties, "progress", &m_progress)) {
         Q_EMIT progressChanged(m_progress);
     }
@@ -1031,18 +1324,25 @@ LauncherApplication::updateOverlaysState(const QString& sender, QMap<QString, QV
         Q_EMIT emblemVisibleChanged(m_emblemVisible);
     }
     if (updateOverlayState(properties, "quicklist", &m_dynamicQuicklistPath)) {
-        setDynamicQuicklistImporter(sender);
+        setDynamicQuicklistImporter(m_pendingOverlaysSender);
     }
 }
 
 void
 LauncherApplication::setDynamicQuicklistImporter(const QString& service)
 {
-    if (m_dynamicQuicklistPath.isEmpty() || service.isEmpty()) {
+    if (!m_dynamicQuicklistImporter.isNull()) {
         m_dynamicQuicklistImporter.reset();
-    } else {
+        sMenuImporterCount--;
+    }
+
+    if (!m_dynamicQuicklistPath.isEmpty() && !service.isEmpty()) {
+        /* Unlike indicator menus, the dynamic quicklist is fetched as soon as
+           it is announced: its actions are added to the menu as soon as it is
+           unfolded, without waiting for them */
         m_dynamicQuicklistImporter.reset(new DBusMenuImporter(service, m_dynamicQuicklistPath));
         m_dynamicQuicklistImporter->updateMenu();
+        sMenuImporterCount++;
         if (m_dynamicQuicklistServiceWatcher == NULL) {
             m_dynamicQuicklistServiceWatcher = new QDBusServiceWatcher(this);
             m_dynamicQuicklistServiceWatcher->setConnection(QDBusConnection::sessionBus());
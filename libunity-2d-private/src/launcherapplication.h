@@ -36,6 +36,7 @@
 #include <QTimer>
 #include <QHash>
 #include <QPointer>
+#include <QSet>
 #include <QScopedPointer>
 
 #include "bamf-application.h"
@@ -46,7 +47,6 @@ void sn_startup_sequence_unref(struct SnStartupSequence*);
 }
 
 class DBusMenuImporter;
-class QFileSystemWatcher;
 class QDBusServiceWatcher;
 
 typedef GObjectScopedPointer<GAppInfo> GAppInfoPointer;
@@ -92,6 +92,12 @@ public:
 
     /* setters */
     void setDesktopFile(const QString& desktop_file);
+    /* Shows the application with the given properties, as saved when the
+       launcher last ran, without reading its desktop file until hydrate()
+       is called or the application is used */
+    void setDesktopFileSnapshot(const QString& desktop_file, const QString& name, const QString& icon);
+    bool hydrated() const;
+    void hydrate();
     void setSticky(bool sticky);
     void setBamfApplication(BamfApplication *application);
     void setSnStartupSequence(SnStartupSequence* sequence);
@@ -105,7 +111,16 @@ public:
 
     Q_INVOKABLE virtual void createMenuActions();
 
+    /* Overlay updates are applied at most once per frame, only the latest
+       value of each property is applied */
     void updateOverlaysState(const QString& sender, QMap<QString, QVariant> properties);
+    /* Number of updates merged into a later one before being applied */
+    int overlayUpdatesDropped() const;
+
+    /* Number of menu importers alive for all the applications, and of menu
+       requests not made because the menus were not used or were prefetched */
+    static int menuImporterCount();
+    static int menuRequestsAvoided();
 
 Q_SIGNALS:
     void stickyChanged(bool);
@@ -134,10 +149,16 @@ private Q_SLOTS:
     void onQuitTriggered();
 
     void onWindowAdded(BamfWindow*);
+    void onWindowRemoved(BamfWindow*);
+    void onWindowWorkspaceChanged(unsigned int xid, int previousWorkspace, int workspace);
 
     void slotChildAdded(BamfView*);
     void slotChildRemoved(BamfView*);
     void onIndicatorMenuUpdated();
+    void onMenuVisibleChanged(bool visible);
+    void prefetchMenus();
+    void evictMenuImporters();
+    void applyOverlaysState();
 
     void onDesktopFileChanged(const QString&);
     void checkDesktopFileReallyRemoved();
@@ -148,28 +169,55 @@ private Q_SLOTS:
 
 private:
     QPointer<BamfApplication> m_application;
-    QFileSystemWatcher *m_desktopFileWatcher;
+    QString m_monitoredDesktopFile;
+    QString m_snapshotDesktopFile;
+    QString m_snapshotName;
+    QString m_snapshotIcon;
     GAppInfoPointer m_appInfo;
     SnStartupSequencePointer m_snStartupSequence;
     bool m_sticky;
     QTimer m_launching_timer;
     bool m_has_visible_window;
+    /* Indicator menu importers are created when the menu is about to be
+       used, from the service of each indicator menu path, and released
+       when the menu was not used for a while */
+    QHash<QString, QString> m_indicatorMenuServices;
     QHash<QString, DBusMenuImporter*> m_indicatorMenus;
+    QSet<DBusMenuImporter*> m_pendingIndicatorMenus;
+    QSet<DBusMenuImporter*> m_updatedIndicatorMenus;
+    bool m_indicatorMenusRequested;
     int m_indicatorMenusReady;
+    QTimer m_menuPrefetchTimer;
+    QTimer m_menuEvictionTimer;
     float m_progress;
     bool m_progressBarVisible;
     int m_counter;
     bool m_counterVisible;
     QString m_emblem;
     bool m_emblemVisible;
+    QTimer m_overlaysUpdateTimer;
+    QMap<QString, QVariant> m_pendingOverlays;
+    QString m_pendingOverlaysSender;
+    int m_overlayUpdatesDropped;
     bool m_forceUrgent;
+    /* Workspace of each window of the application and number of them on
+       each workspace, following WindowWorkspaceIndex */
+    QHash<unsigned int, int> m_windowWorkspaces;
+    QHash<int, int> m_windowCountByWorkspace;
 
     void updateBamfApplicationDependentProperties();
     void monitorDesktopFile(const QString&);
     void fetchIndicatorMenus();
+    void createMenuImporters();
+    void deleteMenuImporters();
+    void insertIndicatorMenuActions(DBusMenuImporter* importer);
     void createDynamicMenuActions();
     void createStaticMenuActions();
+    IndicatorDesktopShortcuts* staticShortcuts();
     int windowCountOnCurrentWorkspace();
+    void clearWindowWorkspaces();
+    void updateWindowWorkspaces();
+    void setWindowWorkspace(unsigned int xid, int workspace);
     template<typename T>
     bool updateOverlayState(QMap<QString, QVariant> properties,
                             QString propertyName, T* member);
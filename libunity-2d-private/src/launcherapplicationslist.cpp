@@ -18,6 +18,8 @@
 #include "launcherapplicationslist.h"
 #include "webfavorite.h"
 #include "launcherapplicationslistdbus.h"
+#include "desktopentryindex.h"
+#include "gnomesessionclient.h"
 
 #include "bamf-matcher.h"
 #include "bamf-application.h"
@@ -31,6 +33,8 @@
 #include <debug_p.h>
 
 #include <QStringList>
+#include <QCoreApplication>
+#include <QDataStream>
 #include <QDir>
 #include <QDBusConnection>
 #include <QDBusMessage>
@@ -44,6 +48,11 @@ extern "C" {
 #include <libsn/sn.h>
 }
 
+#include <X11/Xutil.h>
+
+#include <glib.h>
+#include <stdio.h>
+
 
 #define LAUNCHER_DCONF_SCHEMA QString("com.canonical.Unity.Launcher")
 #define LAUNCHER_DCONF_PATH QString("/desktop/unity/launcher")
@@ -55,12 +64,49 @@ extern "C" {
 /* List of executables that are too generic to be matched against a single application. */
 static const QStringList EXECUTABLES_BLACKLIST = (QStringList() << "xdg-open");
 static const QByteArray LATEST_SETTINGS_MIGRATION = "3.2.10";
+/* Favorites are written once they did not change for that long, so that
+   dragging a launcher item over many others writes them once */
+static const int FAVORITES_WRITE_DELAY = 500;
+/* Time the favorites migration tool is given to finish when the session
+   ends with changes to the favorites not written, and to die once killed.
+   gnome-session waits for the launcher meanwhile. */
+static const int MIGRATION_QUIT_TIMEOUT = 1000;
+static const int MIGRATION_KILL_TIMEOUT = 100;
+
+static const quint32 SNAPSHOT_MAGIC = 0x55324446; /* "U2DF" */
+/* To be bumped whenever the layout of the snapshot file changes */
+static const quint32 SNAPSHOT_FORMAT_VERSION = 1;
+/* Each favorite of the snapshot is saved as its desktop file, name and icon */
+enum SnapshotField {
+    SnapshotDesktopFile,
+    SnapshotName,
+    SnapshotIcon,
+    SnapshotFieldCount
+};
 
 LauncherApplicationsList::LauncherApplicationsList(QObject *parent) :
-    QAbstractListModel(parent)
+    QAbstractListModel(parent),
+    m_favoritesWritesAvoided(0),
+    m_migrationProcess(NULL),
+    m_favoritesChangedDuringMigration(false)
 {
+    m_startupTimer.start();
     m_dconf_launcher = new QConf(LAUNCHER_DCONF_SCHEMA);
 
+    m_favoritesWriteTimer.setSingleShot(true);
+    m_favoritesWriteTimer.setInterval(FAVORITES_WRITE_DELAY);
+    connect(&m_favoritesWriteTimer, SIGNAL(timeout()), SLOT(writeFavoritesToGConf()));
+    connect(DesktopEntryIndex::instance(), SIGNAL(changed()), SLOT(onDesktopEntriesChanged()));
+    /* Write pending changes before gnome-session is told that the session
+       can end, the destructor takes care of the other ways of quitting */
+    GnomeSessionClient* sessionClient = GnomeSessionClient::instance();
+    if (sessionClient != NULL) {
+        connect(sessionClient, SIGNAL(sessionEnding()), SLOT(flushFavorites()));
+    }
+
+    m_hydrationTimer.setInterval(0);
+    connect(&m_hydrationTimer, SIGNAL(timeout()), SLOT(hydrateNextApplication()));
+
     QDBusConnection session = QDBusConnection::sessionBus();
     /* FIXME: libunity will send out the Update signal for LauncherEntries
        only if it finds com.canonical.Unity on the bus, so let's just quickly
@@ -183,6 +229,8 @@ LauncherApplicationsList::onRemoteEntryUpdated(QString applicationURI, QMap<QStr
 
 LauncherApplicationsList::~LauncherApplicationsList()
 {
+    flushFavorites();
+
     sn_monitor_context_unref(m_snContext);
     sn_display_unref(m_snDisplay);
 
@@ -240,6 +288,7 @@ LauncherApplicationsList::removeApplication(LauncherApplication* application)
 
     beginRemoveRows(QModelIndex(), index, index);
     m_applications.removeAt(index);
+    m_applicationsToHydrate.removeOne(application);
     m_applicationForDesktopFile.remove(application->desktop_file());
     m_applicationForExecutable.remove(application->executable());
     endRemoveRows();
@@ -263,6 +312,29 @@ LauncherApplicationsList::onApplicationUserVisibleChanged(bool user_visible)
     }
 }
 
+/* Returns the WM_CLASS class of the first window of the application that
+   has one, or its instance name if it has no class */
+static QString wmClassForApplication(BamfApplication* application)
+{
+    QScopedPointer<BamfUintList> xids(application->xids());
+    for (int i = 0; i < xids->size(); i++) {
+        XClassHint hint;
+        if (XGetClassHint(QX11Info::display(), xids->at(i), &hint) == 0) {
+            continue;
+        }
+        QString wmClass = QString::fromLocal8Bit(hint.res_class);
+        if (wmClass.isEmpty()) {
+            wmClass = QString::fromLocal8Bit(hint.res_name);
+        }
+        XFree(hint.res_name);
+        XFree(hint.res_class);
+        if (!wmClass.isEmpty()) {
+            return wmClass;
+        }
+    }
+    return QString();
+}
+
 void LauncherApplicationsList::insertBamfApplication(BamfApplication* bamf_application)
 {
     /* Only insert BamfApplications for which the user_visible property is true.
@@ -283,9 +355,23 @@ void LauncherApplicationsList::insertBamfApplication(BamfApplication* bamf_appli
 
     QString executable = newApplication->executable();
     QString desktop_file = newApplication->desktop_file();
+    QString wmClassDesktopFile;
+    if (desktop_file.isEmpty()) {
+        /* BAMF did not find the desktop file of the application, the
+           StartupWMClass key of the desktop files may tell which one it is */
+        QString wmClass = wmClassForApplication(bamf_application);
+        if (!wmClass.isEmpty()) {
+            wmClassDesktopFile = DesktopEntryIndex::instance()->fileForWMClass(wmClass);
+        }
+    }
+
     if (m_applicationForDesktopFile.contains(desktop_file)) {
         /* A LauncherApplication with the same desktop file already exists */
         matchingApplication = m_applicationForDesktopFile[desktop_file];
+    } else if (m_applicationForDesktopFile.contains(wmClassDesktopFile)) {
+        /* A LauncherApplication whose desktop file has the WM_CLASS of the
+           windows of the application as StartupWMClass already exists */
+        matchingApplication = m_applicationForDesktopFile[wmClassDesktopFile];
     } else if (m_applicationForExecutable.contains(executable)) {
         /* A LauncherApplication with the same executable already exists */
         matchingApplication = m_applicationForExecutable[executable];
@@ -302,10 +388,6 @@ void LauncherApplicationsList::insertBamfApplication(BamfApplication* bamf_appli
 
     if (matchingApplication != NULL) {
         /* A LauncherApplication that corresponds to bamf_application already exists */
-        /* FIXME: this deletion blocks for a long time (around 100ms here) and
-           leads to a visual glitch in the launcher when an application finished
-           starting up. This is due to the deletion of the QFileSystemWatcher
-           belonging to the LauncherApplication. */
         delete newApplication;
         matchingApplication->setBamfApplication(bamf_application);
     } else {
@@ -330,6 +412,15 @@ LauncherApplicationsList::insertFavoriteApplication(QString desktop_file)
         UQ_WARNING << "Favorite application not added due to desktop file missing or corrupted ("
                    << desktop_file << ")";
         delete application;
+        /* Tried again when desktop files are installed, see
+           onDesktopEntriesChanged */
+        if (!m_unresolvedFavorites.contains(desktop_file)) {
+            m_unresolvedFavorites.append(desktop_file);
+        }
+    } else if (m_applicationForDesktopFile.contains(application->desktop_file())) {
+        /* The favorite was given by its desktop file id and is already
+           in the launcher under the full path of the desktop file */
+        delete application;
     } else {
         /* Register favorite desktop file into BAMF: applications with the same
            executable file will match with the given desktop file. This replicates
@@ -347,6 +438,40 @@ LauncherApplicationsList::insertFavoriteApplication(QString desktop_file)
     }
 }
 
+void
+LauncherApplicationsList::onDesktopEntriesChanged()
+{
+    /* Favorites that could not be resolved may have been installed since,
+       for example when Software Center adds a favorite for an application
+       it is installing */
+    QStringList favorites = m_unresolvedFavorites;
+    m_unresolvedFavorites.clear();
+    Q_FOREACH(const QString& favorite, favorites) {
+        insertFavoriteApplication(favorite);
+    }
+}
+
+void
+LauncherApplicationsList::insertFavoriteSnapshot(const QStringList& snapshot)
+{
+    QString desktop_file = snapshot.at(SnapshotDesktopFile);
+    if (m_applicationForDesktopFile.contains(desktop_file)) {
+        return;
+    }
+
+    LauncherApplication* application = new LauncherApplication;
+    application->setDesktopFileSnapshot(desktop_file, snapshot.at(SnapshotName),
+                                        snapshot.at(SnapshotIcon));
+
+    /* See insertFavoriteApplication */
+    BamfMatcher& matcher = BamfMatcher::get_default();
+    matcher.register_favorites(QStringList(desktop_file));
+
+    insertApplication(application);
+    application->setSticky(true);
+    m_applicationsToHydrate.append(application);
+}
+
 void
 LauncherApplicationsList::insertWebFavorite(const QUrl& url)
 {
@@ -375,9 +500,14 @@ LauncherApplicationsList::insertSnStartupSequence(SnStartupSequence* sequence)
         return;
     }
 
+    QString desktop_file = DesktopEntryIndex::instance()->fileForExecutable(executable);
     if (m_applicationForExecutable.contains(executable)) {
         /* A LauncherApplication with the same executable already exists */
         m_applicationForExecutable[executable]->setSnStartupSequence(sequence);
+    } else if (!desktop_file.isEmpty() && m_applicationForDesktopFile.contains(desktop_file)) {
+        /* The executable is the one of a desktop file already in the
+           launcher, with an Exec line giving its full path */
+        m_applicationForDesktopFile[desktop_file]->setSnStartupSequence(sequence);
     } else {
         /* Create a new LauncherApplication and append it to the list */
         LauncherApplication* newApplication = new LauncherApplication;
@@ -386,23 +516,191 @@ LauncherApplicationsList::insertSnStartupSequence(SnStartupSequence* sequence)
     }
 }
 
+QString
+LauncherApplicationsList::snapshotFile()
+{
+    return QString::fromUtf8(g_get_user_cache_dir()) + "/unity-2d/launcher-favorites";
+}
+
+QHash<QString, QStringList>
+LauncherApplicationsList::loadSnapshot() const
+{
+    QHash<QString, QStringList> snapshot;
+    QFile file(snapshotFile());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return snapshot;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_FORMAT_VERSION) {
+        return snapshot;
+    }
+    stream >> snapshot;
+    if (stream.status() != QDataStream::Ok) {
+        snapshot.clear();
+    }
+
+    /* Entries that are not complete are ignored rather than trusted */
+    QHash<QString, QStringList>::iterator it = snapshot.begin();
+    while (it != snapshot.end()) {
+        if (it.value().count() != SnapshotFieldCount || it.value().at(SnapshotDesktopFile).isEmpty()) {
+            it = snapshot.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return snapshot;
+}
+
 void
-LauncherApplicationsList::load()
+LauncherApplicationsList::saveSnapshot() const
 {
-    /* Migrate the favorites if needed and ignore errors */
-    QByteArray latest_migration = m_dconf_launcher->property("favoriteMigration").toString().toAscii();
-    if (latest_migration < LATEST_SETTINGS_MIGRATION) {
-        if(QProcess::execute(INSTALL_PREFIX "/lib/unity/migrate_favorites.py") != 0) {
-            UQ_WARNING << "Unable to run the migrate favorites tool successfully";
+    QHash<QString, QStringList> snapshot;
+    Q_FOREACH(LauncherApplication *application, m_applications) {
+        QString desktop_file = application->desktop_file();
+        if (application->sticky() && !desktop_file.isEmpty()) {
+            snapshot.insert(favoriteFromDesktopFilePath(desktop_file),
+                            QStringList() << desktop_file << application->name()
+                                          << application->icon());
+        }
+    }
+
+    QString path = snapshotFile();
+    QDir().mkpath(QFileInfo(path).path());
+    QString temporaryPath = QString("%1.%2").arg(path).arg(QCoreApplication::applicationPid());
+    QFile file(temporaryPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        UQ_WARNING << "Failed to write launcher favorites snapshot" << temporaryPath;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+    stream << SNAPSHOT_MAGIC << SNAPSHOT_FORMAT_VERSION << snapshot;
+    file.close();
+
+    if (stream.status() != QDataStream::Ok
+        || ::rename(QFile::encodeName(temporaryPath).constData(),
+                    QFile::encodeName(path).constData()) != 0) {
+        QFile::remove(temporaryPath);
+    }
+}
+
+void
+LauncherApplicationsList::startFavoritesMigration()
+{
+    /* The migration tool writes the favorites to dconf itself; the
+       launcher shows the favorites it finds meanwhile and adds the
+       migrated ones when it is done */
+    m_migrationProcess = new QProcess(this);
+    connect(m_migrationProcess, SIGNAL(finished(int, QProcess::ExitStatus)),
+            SLOT(onMigrationFinished(int, QProcess::ExitStatus)));
+    connect(m_migrationProcess, SIGNAL(error(QProcess::ProcessError)),
+            SLOT(onMigrationError(QProcess::ProcessError)));
+    m_migrationProcess->start(INSTALL_PREFIX "/lib/unity/migrate_favorites.py");
+}
+
+void
+LauncherApplicationsList::onMigrationFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    /* Errors are ignored, as the favorites are migrated at best */
+    if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+        UQ_WARNING << "Unable to run the migrate favorites tool successfully";
+    }
+    finishFavoritesMigration();
+}
+
+void
+LauncherApplicationsList::onMigrationError(QProcess::ProcessError error)
+{
+    /* A crash is reported by finished() as well */
+    if (error == QProcess::FailedToStart) {
+        UQ_WARNING << "Unable to run the migrate favorites tool successfully";
+        finishFavoritesMigration();
+    }
+}
+
+void
+LauncherApplicationsList::finishFavoritesMigration()
+{
+    if (m_migrationProcess == NULL) {
+        return;
+    }
+    m_migrationProcess->deleteLater();
+    m_migrationProcess = NULL;
+
+    UQ_DEBUG << "Launcher startup: favorites migrated after" << m_startupTimer.elapsed() << "ms";
+
+    /* Changes the user made to the favorites during the migration take
+       precedence over the migrated ones; they were not written yet */
+    if (m_favoritesChangedDuringMigration) {
+        m_favoritesChangedDuringMigration = false;
+        scheduleFavoritesWrite();
+        return;
+    }
+
+    /* Otherwise the launcher shows the migrated favorites, in their order */
+    QStringList favorites = m_dconf_launcher->property("favorites").toStringList();
+    m_writtenFavorites = favorites;
+    Q_FOREACH(LauncherApplication* application, QList<LauncherApplication*>(m_applications)) {
+        if (application->sticky()
+            && !favorites.contains(favoriteFromDesktopFilePath(application->desktop_file()))) {
+            /* Removed from the launcher unless running */
+            application->setSticky(false);
         }
     }
+    Q_FOREACH(QString favorite, favorites) {
+        insertFavoriteApplication(favorite);
+    }
+
+    int position = 0;
+    Q_FOREACH(QString favorite, favorites) {
+        for (int index = position; index < m_applications.size(); index++) {
+            LauncherApplication* application = m_applications.at(index);
+            if (application->sticky()
+                && favoriteFromDesktopFilePath(application->desktop_file()) == favorite) {
+                if (index != position) {
+                    beginMoveRows(QModelIndex(), index, index, QModelIndex(), position);
+                    m_applications.move(index, position);
+                    endMoveRows();
+                }
+                position++;
+                break;
+            }
+        }
+    }
+}
 
-    /* Insert favorites */
-    QString desktop_file;
+void
+LauncherApplicationsList::load()
+{
+    /* Insert favorites, from the snapshot of the last run when they are
+       in it, so that the launcher is painted without reading any of their
+       desktop files */
+    QHash<QString, QStringList> snapshot = loadSnapshot();
     QStringList favorites = m_dconf_launcher->property("favorites").toStringList();
+    m_writtenFavorites = favorites;
 
     Q_FOREACH(QString favorite, favorites) {
-       insertFavoriteApplication(favorite);
+        if (snapshot.contains(favorite)) {
+            insertFavoriteSnapshot(snapshot.value(favorite));
+        } else {
+            insertFavoriteApplication(favorite);
+        }
+    }
+    UQ_DEBUG << "Launcher startup:" << favorites.count() << "favorites inserted,"
+             << m_applicationsToHydrate.count() << "from the snapshot, after"
+             << m_startupTimer.elapsed() << "ms";
+
+    /* Migrate the favorites if needed, once the ones found are inserted so
+       that inserting them is not taken for changes made by the user */
+    QByteArray latest_migration = m_dconf_launcher->property("favoriteMigration").toString().toAscii();
+    if (latest_migration < LATEST_SETTINGS_MIGRATION) {
+        startFavoritesMigration();
     }
 
     /* Insert running applications from Bamf */
@@ -414,8 +712,55 @@ LauncherApplicationsList::load()
         bamf_application = running_applications->at(i);
         insertBamfApplication(bamf_application);
     }
+    UQ_DEBUG << "Launcher startup: running applications inserted after"
+             << m_startupTimer.elapsed() << "ms";
 
     QObject::connect(&matcher, SIGNAL(ViewOpened(BamfView*)), SLOT(onBamfViewOpened(BamfView*)));
+
+    QTimer::singleShot(0, this, SLOT(onEventLoopReached()));
+}
+
+void
+LauncherApplicationsList::onEventLoopReached()
+{
+    /* Events posted while the launcher was loaded, painting it first
+       among them, have been processed */
+    UQ_DEBUG << "Launcher startup: event loop reached after" << m_startupTimer.elapsed() << "ms";
+    m_hydrationTimer.start();
+}
+
+void
+LauncherApplicationsList::hydrateNextApplication()
+{
+    if (m_applicationsToHydrate.isEmpty()) {
+        m_hydrationTimer.stop();
+        UQ_DEBUG << "Launcher startup: favorites hydrated after" << m_startupTimer.elapsed() << "ms";
+        saveSnapshot();
+        return;
+    }
+
+    /* The desktop file read may differ from the one of the snapshot, or be
+       gone since the last run */
+    LauncherApplication* application = m_applicationsToHydrate.takeFirst();
+    QString snapshotDesktopFile = application->desktop_file();
+    application->hydrate();
+    QString desktop_file = application->desktop_file();
+    if (desktop_file != snapshotDesktopFile) {
+        m_applicationForDesktopFile.remove(snapshotDesktopFile);
+        if (desktop_file.isEmpty()) {
+            UQ_WARNING << "Favorite application removed due to desktop file missing or corrupted ("
+                       << snapshotDesktopFile << ")";
+            removeApplication(application);
+            return;
+        }
+        m_applicationForDesktopFile.insert(desktop_file, application);
+    }
+
+    QString executable = application->executable();
+    if (!executable.isEmpty() && !EXECUTABLES_BLACKLIST.contains(executable)
+        && !m_applicationForExecutable.contains(executable)) {
+        m_applicationForExecutable.insert(executable, application);
+    }
 }
 
 void
@@ -446,7 +791,7 @@ LauncherApplicationsList::onApplicationStickyChanged(bool sticky)
 {
     LauncherApplication* application = static_cast<LauncherApplication*>(sender());
 
-    writeFavoritesToGConf();
+    scheduleFavoritesWrite();
 
     if (!sticky && !application->running()) {
         removeApplication(application);
@@ -472,9 +817,55 @@ LauncherApplicationsList::onApplicationUrgentChanged(bool urgent)
     }
 }
 
+int
+LauncherApplicationsList::favoritesWritesAvoided() const
+{
+    return m_favoritesWritesAvoided;
+}
+
+void
+LauncherApplicationsList::scheduleFavoritesWrite()
+{
+    if (m_migrationProcess != NULL) {
+        m_favoritesChangedDuringMigration = true;
+    }
+    if (m_favoritesWriteTimer.isActive()) {
+        m_favoritesWritesAvoided++;
+    }
+    m_favoritesWriteTimer.start();
+}
+
+void
+LauncherApplicationsList::flushFavorites()
+{
+    if (m_migrationProcess != NULL && m_favoritesChangedDuringMigration) {
+        /* Give the migration tool some time to finish, so that its result
+           is not written over. Either way the changes made by the user are
+           written below. This blocks for at most MIGRATION_QUIT_TIMEOUT
+           plus MIGRATION_KILL_TIMEOUT. */
+        if (!m_migrationProcess->waitForFinished(MIGRATION_QUIT_TIMEOUT)) {
+            m_migrationProcess->kill();
+            m_migrationProcess->waitForFinished(MIGRATION_KILL_TIMEOUT);
+        }
+        finishFavoritesMigration();
+    }
+
+    if (m_favoritesWriteTimer.isActive()) {
+        writeFavoritesToGConf();
+    }
+}
+
 void
 LauncherApplicationsList::writeFavoritesToGConf()
 {
+    m_favoritesWriteTimer.stop();
+
+    /* The migration tool is writing the favorites, they are written again
+       once it is done */
+    if (m_migrationProcess != NULL) {
+        return;
+    }
+
     QStringList favorites;
 
     Q_FOREACH(LauncherApplication *application, m_applications) {
@@ -484,9 +875,18 @@ LauncherApplicationsList::writeFavoritesToGConf()
         }
     }
 
+    /* For example an item dragged back where it was */
+    if (favorites == m_writtenFavorites) {
+        m_favoritesWritesAvoided++;
+        return;
+    }
+
     m_dconf_launcher->blockSignals(true);
     m_dconf_launcher->setProperty("favorites", QVariant(favorites));
     m_dconf_launcher->blockSignals(false);
+    m_writtenFavorites = favorites;
+    saveSnapshot();
+    UQ_DEBUG << "Favorites written," << m_favoritesWritesAvoided << "writes avoided so far";
 }
 
 int
@@ -522,7 +922,7 @@ LauncherApplicationsList::move(int from, int to)
 
     if (m_applications[from]->sticky() || m_applications[to]->sticky()) {
         /* Update favorites only if at least one of the applications is a favorite */
-        writeFavoritesToGConf();
+        scheduleFavoritesWrite();
     }
 }
 
@@ -26,6 +26,10 @@
 #include <QtDeclarative/qdeclarative.h>
 #include <QMap>
 #include <QDBusContext>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QProcess>
 
 #include <unity2dapplication.h>
 
@@ -53,8 +57,18 @@ public:
     Q_INVOKABLE void insertFavoriteApplication(QString desktop_file);
     Q_INVOKABLE void insertWebFavorite(const QUrl& url);
 
+    /* Number of times the favorites were not written to dconf because they
+       were changed again before being written or did not change */
+    int favoritesWritesAvoided() const;
+
+    /* File where the favorites, as last shown, are saved to be shown
+       without reading their desktop files the next time the launcher starts */
+    static QString snapshotFile();
+
 public Q_SLOTS:
     void move(int from, int to);
+    /* Writes the changes to the favorites not written yet */
+    void flushFavorites();
 
 Q_SIGNALS:
     void applicationBecameUrgent(int index);
@@ -64,6 +78,11 @@ protected:
 
 private:
     void load();
+    QHash<QString, QStringList> loadSnapshot() const;
+    void saveSnapshot() const;
+    void startFavoritesMigration();
+    void finishFavoritesMigration();
+    void insertFavoriteSnapshot(const QStringList& snapshot);
     void insertBamfApplication(BamfApplication* bamf_application);
     void insertSnStartupSequence(SnStartupSequence* sequence);
 
@@ -72,7 +91,7 @@ private:
 
     QString favoriteFromDesktopFilePath(const QString& desktop_file) const;
 
-    void writeFavoritesToGConf();
+    void scheduleFavoritesWrite();
 
     /* List of LauncherApplication displayed in the launcher. */
     QList<LauncherApplication*> m_applications;
@@ -91,6 +110,22 @@ private:
     QConf* m_dconf_launcher;
     QStringList m_xdgApplicationDirs;
 
+    /* Changes to the favorites are written once they stopped changing for
+       a moment, and when the application quits */
+    QTimer m_favoritesWriteTimer;
+    QStringList m_writtenFavorites;
+    int m_favoritesWritesAvoided;
+
+    /* The launcher starts with the favorites saved in the snapshot, their
+       desktop files are then read one at a time from the event loop */
+    QList<LauncherApplication*> m_applicationsToHydrate;
+    QTimer m_hydrationTimer;
+    QProcess* m_migrationProcess;
+    bool m_favoritesChangedDuringMigration;
+    QElapsedTimer m_startupTimer;
+    /* Favorites whose desktop file could not be found */
+    QStringList m_unresolvedFavorites;
+
     /* Startup notification support */
     SnDisplay *m_snDisplay;
     SnMonitorContext *m_snContext;
@@ -98,12 +133,18 @@ private:
     void onSnMonitorEventReceived(SnMonitorEvent *event);
 
 private Q_SLOTS:
+    void writeFavoritesToGConf();
+    void onEventLoopReached();
+    void hydrateNextApplication();
+    void onMigrationFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onMigrationError(QProcess::ProcessError error);
     void onApplicationClosed();
     void onBamfViewOpened(BamfView* bamf_view);
     void onApplicationStickyChanged(bool sticky);
     void onApplicationLaunchingChanged(bool launching);
     void onApplicationUrgentChanged(bool urgent);
     void onApplicationUserVisibleChanged(bool user_visible);
+    void onDesktopEntriesChanged();
     void onRemoteEntryUpdated(QString applicationURI,
                               QMap<QString, QVariant> properties);
 };
@@ -61,8 +61,9 @@ void ScreenInfo::updateActiveWindow(WnckScreen *screen)
 }
 
 /* FIXME: This should be removed when we find a cleaner way to bypass the
-   QML Image cache. See SpreadWindow.qml and WindowImageProvider::requestImage
-   for details. */
+   QML Image cache for the root window. Spread windows already use
+   WindowInfo::thumbnailGeneration instead. See Window.qml and
+   WindowImageProvider::requestImage for details. */
 QString ScreenInfo::currentTime()
 {
     return QString::number(time(NULL));
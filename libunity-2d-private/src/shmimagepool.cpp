@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "shmimagepool.h"
+
+// Local
+#include <debug_p.h>
+
+// Qt
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+// System
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+// X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+/* Segments are allocated in multiples of this size, so that windows being
+   resized by a few pixels still fit in the segment used previously */
+static const size_t SEGMENT_GRANULARITY = 256 * 1024;
+
+/* Maximum number of segments kept around. Reads are serialized, so in
+   practice one segment big enough for the largest window is enough. */
+static const int MAX_SEGMENTS = 2;
+
+struct ShmSegment
+{
+    XShmSegmentInfo info;
+    size_t size;
+};
+
+/* X error handlers are global to the process, pools living in capture
+   worker threads must not install theirs concurrently */
+static QMutex sAttachMutex;
+static bool sAttachFailed = false;
+
+static int attachErrorHandler(Display* display, XErrorEvent* event)
+{
+    Q_UNUSED(display);
+    Q_UNUSED(event);
+    sAttachFailed = true;
+    return 0;
+}
+
+struct ShmImagePoolPrivate
+{
+    ShmImagePoolPrivate(Display* display)
+    : m_display(display)
+    , m_available(false)
+    , m_image(NULL)
+    {}
+
+    ShmSegment* createSegment(size_t size);
+    void destroySegment(ShmSegment* segment);
+    ShmSegment* segment(size_t size);
+    Visual* visual(unsigned long visualId);
+    void releaseImage();
+
+    Display* m_display;
+    bool m_available;
+    QList<ShmSegment*> m_segments;
+    QHash<unsigned long, Visual*> m_visuals;
+    XImage* m_image;
+};
+
+ShmSegment* ShmImagePoolPrivate::createSegment(size_t size)
+{
+    size = ((size + SEGMENT_GRANULARITY - 1) / SEGMENT_GRANULARITY) * SEGMENT_GRANULARITY;
+
+    ShmSegment* segment = new ShmSegment;
+    segment->size = size;
+    segment->info.readOnly = False;
+    segment->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (segment->info.shmid < 0) {
+        UQ_WARNING << "Failed to allocate a shared memory segment of" << size << "bytes";
+        delete segment;
+        return NULL;
+    }
+
+    segment->info.shmaddr = static_cast<char*>(shmat(segment->info.shmid, NULL, 0));
+    if (segment->info.shmaddr == reinterpret_cast<char*>(-1)) {
+        shmctl(segment->info.shmid, IPC_RMID, NULL);
+        delete segment;
+        return NULL;
+    }
+
+    /* Attaching fails when the server is not on the same machine as we are,
+       which is reported asynchronously as an X error */
+    QMutexLocker locker(&sAttachMutex);
+    sAttachFailed = false;
+    XErrorHandler previousHandler = XSetErrorHandler(attachErrorHandler);
+    XShmAttach(m_display, &segment->info);
+    XSync(m_display, False);
+    XSetErrorHandler(previousHandler);
+
+    /* The segment will be destroyed as soon as both us and the server
+       detached from it, even if we crash */
+    shmctl(segment->info.shmid, IPC_RMID, NULL);
+
+    if (sAttachFailed) {
+        UQ_WARNING << "Failed to attach shared memory segment, disabling MIT-SHM captures";
+        shmdt(segment->info.shmaddr);
+        delete segment;
+        m_available = false;
+        return NULL;
+    }
+
+    return segment;
+}
+
+void ShmImagePoolPrivate::destroySegment(ShmSegment* segment)
+{
+    XShmDetach(m_display, &segment->info);
+    shmdt(segment->info.shmaddr);
+    delete segment;
+}
+
+ShmSegment* ShmImagePoolPrivate::segment(size_t size)
+{
+    ShmSegment* best = NULL;
+    Q_FOREACH(ShmSegment* segment, m_segments) {
+        if (segment->size >= size && (best == NULL || segment->size < best->size)) {
+            best = segment;
+        }
+    }
+    if (best != NULL) {
+        return best;
+    }
+
+    ShmSegment* segment = createSegment(size);
+    if (segment == NULL) {
+        return NULL;
+    }
+
+    /* Make room by throwing away the smallest segments, which are the least
+       likely to be reused */
+    while (m_segments.count() >= MAX_SEGMENTS) {
+        int smallest = 0;
+        for (int i = 1; i < m_segments.count(); i++) {
+            if (m_segments.at(i)->size < m_segments.at(smallest)->size) {
+                smallest = i;
+            }
+        }
+        destroySegment(m_segments.takeAt(smallest));
+    }
+    m_segments.append(segment);
+    return segment;
+}
+
+Visual* ShmImagePoolPrivate::visual(unsigned long visualId)
+{
+    if (m_visuals.contains(visualId)) {
+        return m_visuals.value(visualId);
+    }
+
+    XVisualInfo visualTemplate;
+    visualTemplate.visualid = visualId;
+    int count = 0;
+    XVisualInfo* visualInfos = XGetVisualInfo(m_display, VisualIDMask, &visualTemplate, &count);
+    Visual* visual = (count > 0) ? visualInfos[0].visual : NULL;
+    if (visualInfos != NULL) {
+        XFree(visualInfos);
+    }
+
+    m_visuals.insert(visualId, visual);
+    return visual;
+}
+
+void ShmImagePoolPrivate::releaseImage()
+{
+    if (m_image != NULL) {
+        /* This only frees the XImage structure, the data is owned by the segment */
+        XDestroyImage(m_image);
+        m_image = NULL;
+    }
+}
+
+ShmImagePool::ShmImagePool(Display* display)
+: d(new ShmImagePoolPrivate(display))
+{
+    d->m_available = XShmQueryExtension(display);
+    if (!d->m_available) {
+        UQ_DEBUG << "Server doesn't support the MIT-SHM extension.";
+    }
+}
+
+ShmImagePool::~ShmImagePool()
+{
+    d->releaseImage();
+    Q_FOREACH(ShmSegment* segment, d->m_segments) {
+        d->destroySegment(segment);
+    }
+    delete d;
+}
+
+bool ShmImagePool::isAvailable() const
+{
+    return d->m_available;
+}
+
+XImage* ShmImagePool::getImage(unsigned long drawable, unsigned long visualId, int depth,
+                               const QRect& rect)
+{
+    if (!d->m_available || rect.isEmpty()) {
+        return NULL;
+    }
+
+    Visual* visual = d->visual(visualId);
+    if (visual == NULL) {
+        return NULL;
+    }
+
+    d->releaseImage();
+
+    XImage* image = XShmCreateImage(d->m_display, visual, depth, ZPixmap, NULL, NULL,
+                                    rect.width(), rect.height());
+    if (image == NULL) {
+        return NULL;
+    }
+
+    ShmSegment* segment = d->segment(image->bytes_per_line * image->height);
+    if (segment == NULL) {
+        XDestroyImage(image);
+        return NULL;
+    }
+    image->data = segment->info.shmaddr;
+    image->obdata = reinterpret_cast<char*>(&segment->info);
+
+    if (!XShmGetImage(d->m_display, drawable, image, rect.x(), rect.y(), AllPlanes)) {
+        /* The drawable most likely went away meanwhile */
+        XDestroyImage(image);
+        return NULL;
+    }
+
+    d->m_image = image;
+    return image;
+}
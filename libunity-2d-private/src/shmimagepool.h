@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHMIMAGEPOOL_H
+#define SHMIMAGEPOOL_H
+
+// Qt
+#include <QRect>
+
+typedef struct _XDisplay Display;
+typedef struct _XImage XImage;
+
+struct ShmImagePoolPrivate;
+
+/**
+ * Reads parts of drawables through the MIT-SHM extension, so that the pixels
+ * are written by the X server directly in memory shared with us instead of
+ * being sent over the socket like XGetImage does.
+ *
+ * The shared memory segments are kept around and reused across reads. Reads
+ * are not thread safe: use one pool per X connection and thread.
+ *
+ * When the extension is not available (for example on a remote display)
+ * isAvailable() returns false and callers are expected to fall back to
+ * XGetImage.
+ */
+class ShmImagePool
+{
+public:
+    explicit ShmImagePool(Display* display);
+    ~ShmImagePool();
+
+    bool isAvailable() const;
+
+    /**
+     * Reads rect from drawable, whose visual and depth must be passed.
+     * The returned image belongs to the pool and is only valid until the next
+     * call to getImage(). Returns NULL on failure.
+     */
+    XImage* getImage(unsigned long drawable, unsigned long visualId, int depth,
+                     const QRect& rect);
+
+private:
+    Q_DISABLE_COPY(ShmImagePool)
+    ShmImagePoolPrivate* const d;
+};
+
+#endif // SHMIMAGEPOOL_H
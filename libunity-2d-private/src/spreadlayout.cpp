@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spreadlayout.h"
+#include "windowinfo.h"
+
+#include <QSet>
+
+#include <math.h>
+
+SpreadLayoutEngine::SpreadLayoutEngine()
+    : m_horizontalSpacing(0)
+    , m_verticalSpacing(0)
+    , m_columns(0)
+    , m_rows(0)
+{
+}
+
+void SpreadLayoutEngine::setGeometry(const QSizeF& size, qreal horizontalSpacing,
+                                     qreal verticalSpacing)
+{
+    m_size = size;
+    m_horizontalSpacing = horizontalSpacing;
+    m_verticalSpacing = verticalSpacing;
+}
+
+QList<quintptr> SpreadLayoutEngine::layout(const QList<Item>& items)
+{
+    int count = items.count();
+    int columns = (count > 0) ? int(ceil(sqrt(qreal(count)))) : 0;
+    int rows = (columns > 0) ? (count + columns - 1) / columns : 0;
+    bool gridChanged = (columns != m_columns || rows != m_rows);
+
+    QHash<quintptr, int> previous = m_cells;
+    m_cells.clear();
+    m_cells.reserve(count);
+    m_items.clear();
+    m_items.reserve(count);
+
+    /* First keep items in the row and column they were in, if it still
+       exists, then put the others in the free cells in order */
+    QVector<bool> taken(columns * rows, false);
+    QList<int> unplaced;
+    for (int i = 0; i < count; i++) {
+        int previousCell = previous.value(items.at(i).id, -1);
+        int cell = -1;
+        if (previousCell != -1) {
+            int row = previousCell / m_columns;
+            int column = previousCell % m_columns;
+            if (row < rows && column < columns) {
+                cell = row * columns + column;
+            }
+        }
+        if (cell == -1 || taken.at(cell)) {
+            unplaced.append(i);
+        } else {
+            taken[cell] = true;
+            m_cells.insert(items.at(i).id, cell);
+        }
+    }
+
+    int freeCell = 0;
+    Q_FOREACH(int i, unplaced) {
+        while (taken.at(freeCell)) {
+            freeCell++;
+        }
+        taken[freeCell] = true;
+        m_cells.insert(items.at(i).id, freeCell);
+    }
+
+    m_columns = columns;
+    m_rows = rows;
+    QHash<quintptr, int>::const_iterator it;
+    for (it = m_cells.constBegin(); it != m_cells.constEnd(); ++it) {
+        m_items.insert(it.value(), it.key());
+    }
+
+    QList<quintptr> changed;
+    for (int i = 0; i < count; i++) {
+        quintptr id = items.at(i).id;
+        if (gridChanged || previous.value(id, -1) != m_cells.value(id)) {
+            changed.append(id);
+        }
+    }
+    return changed;
+}
+
+int SpreadLayoutEngine::cell(quintptr id) const
+{
+    return m_cells.value(id, -1);
+}
+
+quintptr SpreadLayoutEngine::item(int cell) const
+{
+    return m_items.value(cell, 0);
+}
+
+int SpreadLayoutEngine::neighbourCell(int cell, int columnStep, int rowStep) const
+{
+    if (cell < 0 || m_columns == 0) {
+        return -1;
+    }
+
+    int column = cell % m_columns + columnStep;
+    int row = cell / m_columns + rowStep;
+    if (column < 0 || column >= m_columns || row < 0 || row >= m_rows) {
+        return -1;
+    }
+    int neighbour = row * m_columns + column;
+    return m_items.contains(neighbour) ? neighbour : -1;
+}
+
+QRectF SpreadLayoutEngine::cellRect(int cell) const
+{
+    if (cell < 0 || m_columns == 0) {
+        return QRectF();
+    }
+
+    qreal cellWidth = m_size.width() / m_columns;
+    qreal cellHeight = m_size.height() / m_rows;
+    return QRectF((cell % m_columns) * cellWidth, (cell / m_columns) * cellHeight,
+                  cellWidth, cellHeight);
+}
+
+QRectF SpreadLayoutEngine::itemRect(int cell, const QSizeF& itemSize) const
+{
+    QRectF rect = cellRect(cell);
+    if (rect.isNull()) {
+        return rect;
+    }
+    QRectF target = rect.adjusted(m_horizontalSpacing, m_verticalSpacing,
+                                  -m_horizontalSpacing, -m_verticalSpacing);
+    if (!target.isValid() || itemSize.isEmpty()) {
+        return target;
+    }
+
+    qreal scale = qMin(qreal(1.0), qMin(target.width() / itemSize.width(),
+                                        target.height() / itemSize.height()));
+    QSizeF size = itemSize * scale;
+    return QRectF(target.x() + (target.width() - size.width()) / 2,
+                  target.y() + (target.height() - size.height()) / 2,
+                  size.width(), size.height());
+}
+
+SpreadLayout::SpreadLayout(QObject *parent)
+    : QSortFilterProxyModelQML(parent)
+    , m_width(0)
+    , m_height(0)
+    , m_horizontalSpacing(0)
+    , m_verticalSpacing(0)
+{
+    /* These are emitted both when the source model changes and when the
+       filter changes */
+    connect(this, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(updateLayout()));
+    connect(this, SIGNAL(rowsRemoved(QModelIndex,int,int)), SLOT(updateLayout()));
+    connect(this, SIGNAL(modelReset()), SLOT(updateLayout()));
+    connect(this, SIGNAL(layoutChanged()), SLOT(updateLayout()));
+}
+
+void SpreadLayout::setSourceModelQObject(QObject *model)
+{
+    QSortFilterProxyModelQML::setSourceModelQObject(model);
+    if (sourceModel() != NULL) {
+        setRoleNames(sourceModel()->roleNames());
+    }
+    updateLayout();
+}
+
+void SpreadLayout::setRoleNames(const QHash<int,QByteArray> &roleNames)
+{
+    QHash<int, QByteArray> names = roleNames;
+    names[RoleCell] = "cell";
+    names[RoleCellRect] = "cellRect";
+    names[RoleThumbnailRect] = "thumbnailRect";
+    QSortFilterProxyModelQML::setRoleNames(names);
+}
+
+QVariant SpreadLayout::data(const QModelIndex &index, int role) const
+{
+    if (role != RoleCell && role != RoleCellRect && role != RoleThumbnailRect) {
+        return QSortFilterProxyModelQML::data(index, role);
+    }
+
+    WindowInfo *info = QSortFilterProxyModelQML::data(index, WindowInfo::RoleWindowInfo)
+                                                .value<WindowInfo*>();
+    int cell = m_engine.cell(quintptr(info));
+    switch (role) {
+    case RoleCell:
+        return QVariant::fromValue(cell);
+    case RoleCellRect:
+        return QVariant::fromValue(m_engine.cellRect(cell));
+    default:
+        return QVariant::fromValue(m_engine.itemRect(cell, (info != NULL) ? info->size() : QSize()));
+    }
+}
+
+int SpreadLayout::neighbourRow(int row, int columnStep, int rowStep) const
+{
+    if (row < 0 || row >= rowCount()) {
+        return -1;
+    }
+
+    WindowInfo *info = QSortFilterProxyModelQML::data(index(row, 0), WindowInfo::RoleWindowInfo)
+                                                .value<WindowInfo*>();
+    int neighbour = m_engine.neighbourCell(m_engine.cell(quintptr(info)), columnStep, rowStep);
+    return m_rows.value(m_engine.item(neighbour), -1);
+}
+
+void SpreadLayout::updateLayout()
+{
+    int previousColumns = m_engine.columns();
+    int previousRows = m_engine.rows();
+
+    QList<SpreadLayoutEngine::Item> items;
+    items.reserve(rowCount());
+    m_rows.clear();
+    for (int row = 0; row < rowCount(); row++) {
+        WindowInfo *info = QSortFilterProxyModelQML::data(index(row, 0), WindowInfo::RoleWindowInfo)
+                                                    .value<WindowInfo*>();
+        SpreadLayoutEngine::Item item;
+        item.id = quintptr(info);
+        item.size = (info != NULL) ? QSizeF(info->size()) : QSizeF();
+        items.append(item);
+        m_rows.insert(item.id, row);
+    }
+
+    QList<quintptr> changed = m_engine.layout(items);
+
+    if (m_engine.columns() != previousColumns) {
+        Q_EMIT columnsChanged(m_engine.columns());
+    }
+    if (m_engine.rows() != previousRows) {
+        Q_EMIT rowsChanged(m_engine.rows());
+    }
+
+    if (changed.count() == items.count()) {
+        if (!items.isEmpty()) {
+            Q_EMIT dataChanged(index(0, 0), index(items.count() - 1, 0));
+        }
+        return;
+    }
+
+    QSet<quintptr> changedIds = changed.toSet();
+    for (int row = 0; row < items.count(); row++) {
+        if (changedIds.contains(items.at(row).id)) {
+            QModelIndex changedItem = index(row, 0);
+            Q_EMIT dataChanged(changedItem, changedItem);
+        }
+    }
+}
+
+void SpreadLayout::updateGeometry()
+{
+    m_engine.setGeometry(QSizeF(m_width, m_height), m_horizontalSpacing, m_verticalSpacing);
+    if (rowCount() > 0) {
+        Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0));
+    }
+}
+
+qreal SpreadLayout::width() const
+{
+    return m_width;
+}
+
+qreal SpreadLayout::height() const
+{
+    return m_height;
+}
+
+qreal SpreadLayout::horizontalSpacing() const
+{
+    return m_horizontalSpacing;
+}
+
+qreal SpreadLayout::verticalSpacing() const
+{
+    return m_verticalSpacing;
+}
+
+int SpreadLayout::columns() const
+{
+    return m_engine.columns();
+}
+
+int SpreadLayout::rows() const
+{
+    return m_engine.rows();
+}
+
+void SpreadLayout::setWidth(qreal width)
+{
+    if (width != m_width) {
+        m_width = width;
+        updateGeometry();
+        Q_EMIT widthChanged(width);
+    }
+}
+
+void SpreadLayout::setHeight(qreal height)
+{
+    if (height != m_height) {
+        m_height = height;
+        updateGeometry();
+        Q_EMIT heightChanged(height);
+    }
+}
+
+void SpreadLayout::setHorizontalSpacing(qreal spacing)
+{
+    if (spacing != m_horizontalSpacing) {
+        m_horizontalSpacing = spacing;
+        updateGeometry();
+        Q_EMIT horizontalSpacingChanged(spacing);
+    }
+}
+
+void SpreadLayout::setVerticalSpacing(qreal spacing)
+{
+    if (spacing != m_verticalSpacing) {
+        m_verticalSpacing = spacing;
+        updateGeometry();
+        Q_EMIT verticalSpacingChanged(spacing);
+    }
+}
+
+#include "spreadlayout.moc"
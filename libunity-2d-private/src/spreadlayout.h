@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPREADLAYOUT_H
+#define SPREADLAYOUT_H
+
+#include "qsortfilterproxymodelqml.h"
+
+#include <QHash>
+#include <QList>
+#include <QRectF>
+#include <QSizeF>
+#include <QVector>
+
+/* Lays out items of various sizes in a grid of cells, as the spread does
+   with windows.
+
+   The grid has as many columns as needed to be roughly square. Items keep
+   the cell they were in when the layout is updated after items were added
+   or removed, as long as that cell still exists, so that the spread does not
+   shuffle all the windows every time one is opened or closed.
+*/
+class SpreadLayoutEngine
+{
+public:
+    struct Item {
+        quintptr id;
+        QSizeF size;
+    };
+
+    SpreadLayoutEngine();
+
+    void setGeometry(const QSizeF& size, qreal horizontalSpacing, qreal verticalSpacing);
+    QSizeF size() const { return m_size; }
+
+    /* Assigns a cell to each item, in one pass. Returns the ids of the
+       items whose cell changed (all of them if the grid changed) */
+    QList<quintptr> layout(const QList<Item>& items);
+
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+    /* Returns -1 if the item is not laid out */
+    int cell(quintptr id) const;
+    /* Returns 0 if no item is in the cell */
+    quintptr item(int cell) const;
+    /* Cell columnStep columns and rowStep rows away from cell, or -1 if it
+       is outside of the grid or empty */
+    int neighbourCell(int cell, int columnStep, int rowStep) const;
+    QRectF cellRect(int cell) const;
+    /* Rectangle of cell in which an item of size itemSize fits with the
+       same aspect ratio, centered. Items are never scaled up. */
+    QRectF itemRect(int cell, const QSizeF& itemSize) const;
+
+private:
+    QSizeF m_size;
+    qreal m_horizontalSpacing;
+    qreal m_verticalSpacing;
+    int m_columns;
+    int m_rows;
+    QHash<quintptr, int> m_cells;
+    QHash<int, quintptr> m_items;
+};
+
+/* Proxy model that adds to the windows of a WindowsList (or of a proxy
+   of it) the geometry of their thumbnail in the spread, computed by
+   SpreadLayoutEngine, as the "cell", "cellRect" and "thumbnailRect" roles. */
+class SpreadLayout : public QSortFilterProxyModelQML
+{
+    Q_OBJECT
+    Q_ENUMS(Roles)
+
+    Q_PROPERTY(QObject* model READ sourceModelQObject WRITE setSourceModelQObject)
+    Q_PROPERTY(qreal width READ width WRITE setWidth NOTIFY widthChanged)
+    Q_PROPERTY(qreal height READ height WRITE setHeight NOTIFY heightChanged)
+    Q_PROPERTY(qreal horizontalSpacing READ horizontalSpacing WRITE setHorizontalSpacing
+                                       NOTIFY horizontalSpacingChanged)
+    Q_PROPERTY(qreal verticalSpacing READ verticalSpacing WRITE setVerticalSpacing
+                                     NOTIFY verticalSpacingChanged)
+    Q_PROPERTY(int columns READ columns NOTIFY columnsChanged)
+    Q_PROPERTY(int rows READ rows NOTIFY rowsChanged)
+
+public:
+    enum Roles {
+        RoleCell = Qt::UserRole + 1,
+        RoleCellRect,
+        RoleThumbnailRect
+    };
+
+    explicit SpreadLayout(QObject *parent = 0);
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    /* Row of the window shown columnStep columns and rowStep rows away from
+       the one of row, or -1 if there is none. Keyboard navigation follows
+       the cells rather than the order of the rows. */
+    Q_INVOKABLE int neighbourRow(int row, int columnStep, int rowStep) const;
+
+    /* getters */
+    qreal width() const;
+    qreal height() const;
+    qreal horizontalSpacing() const;
+    qreal verticalSpacing() const;
+    int columns() const;
+    int rows() const;
+
+    /* setters */
+    void setSourceModelQObject(QObject *model);
+    void setWidth(qreal width);
+    void setHeight(qreal height);
+    void setHorizontalSpacing(qreal spacing);
+    void setVerticalSpacing(qreal spacing);
+
+    Q_SLOT void setRoleNames(const QHash<int,QByteArray> &roleNames);
+
+Q_SIGNALS:
+    void widthChanged(qreal width);
+    void heightChanged(qreal height);
+    void horizontalSpacingChanged(qreal spacing);
+    void verticalSpacingChanged(qreal spacing);
+    void columnsChanged(int columns);
+    void rowsChanged(int rows);
+
+private Q_SLOTS:
+    void updateLayout();
+
+private:
+    void updateGeometry();
+
+    SpreadLayoutEngine m_engine;
+    QHash<quintptr, int> m_rows;
+    qreal m_width;
+    qreal m_height;
+    qreal m_horizontalSpacing;
+    qreal m_verticalSpacing;
+};
+
+#endif // SPREADLAYOUT_H
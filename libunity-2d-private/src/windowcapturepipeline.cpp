@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "windowcapturepipeline.h"
+
+// Local
+#include "windowgrabber.h"
+#include <debug_p.h>
+
+// Qt
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <QX11Info>
+
+// X11
+#include <X11/Xlib.h>
+
+static const int MAX_WORKERS = 4;
+
+struct CaptureJob
+{
+    unsigned int windowId;
+    QSize requestedSize;
+    int priority;
+    bool smooth;
+};
+
+struct WindowCapturePipelinePrivate
+{
+    WindowCapturePipelinePrivate()
+    : m_quit(false)
+    {}
+
+    bool takeJob(CaptureJob* job);
+
+    QList<CaptureWorker*> m_workers;
+
+    /* Protects everything below */
+    QMutex m_mutex;
+    QWaitCondition m_jobAvailable;
+    /* Sorted by decreasing priority */
+    QList<CaptureJob> m_jobs;
+    bool m_quit;
+};
+
+/* Blocks until a job is available and returns true, or returns false when
+   the pipeline is being destroyed. */
+bool WindowCapturePipelinePrivate::takeJob(CaptureJob* job)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_jobs.isEmpty() && !m_quit) {
+        m_jobAvailable.wait(&m_mutex);
+    }
+    if (m_quit) {
+        return false;
+    }
+    *job = m_jobs.takeFirst();
+    return true;
+}
+
+class CaptureWorker : public QThread
+{
+public:
+    CaptureWorker(WindowCapturePipeline* pipeline, WindowCapturePipelinePrivate* pipelinePrivate,
+                  Display* display)
+    : m_pipeline(pipeline)
+    , m_pipelinePrivate(pipelinePrivate)
+    , m_display(display)
+    {}
+
+    ~CaptureWorker()
+    {
+        XCloseDisplay(m_display);
+    }
+
+protected:
+    void run()
+    {
+        WindowGrabber grabber(m_display);
+        CaptureJob job;
+        while (m_pipelinePrivate->takeJob(&job)) {
+            QImage image = grabber.grab(job.windowId, job.requestedSize, job.smooth);
+            m_pipeline->deliver(job.windowId, image);
+        }
+    }
+
+private:
+    WindowCapturePipeline* m_pipeline;
+    WindowCapturePipelinePrivate* m_pipelinePrivate;
+    Display* m_display;
+};
+
+WindowCapturePipeline::WindowCapturePipeline(int workerCount, QObject* parent)
+: QObject(parent)
+, d(new WindowCapturePipelinePrivate)
+{
+    if (workerCount <= 0) {
+        workerCount = qBound(1, QThread::idealThreadCount(), MAX_WORKERS);
+    }
+
+    /* Each worker gets its own connection: Xlib connections must not be
+       shared between threads unless XInitThreads() was called first, which
+       Qt does not do. */
+    const char* displayName = DisplayString(QX11Info::display());
+    for (int i = 0; i < workerCount; i++) {
+        Display* display = XOpenDisplay(displayName);
+        if (display == NULL) {
+            UQ_WARNING << "Failed to open a connection to" << displayName
+                       << "for window captures";
+            break;
+        }
+        CaptureWorker* worker = new CaptureWorker(this, d, display);
+        d->m_workers.append(worker);
+        worker->start(QThread::LowPriority);
+    }
+}
+
+WindowCapturePipeline::~WindowCapturePipeline()
+{
+    {
+        QMutexLocker locker(&d->m_mutex);
+        d->m_quit = true;
+        d->m_jobAvailable.wakeAll();
+    }
+    Q_FOREACH(CaptureWorker* worker, d->m_workers) {
+        worker->wait();
+        delete worker;
+    }
+    delete d;
+}
+
+bool WindowCapturePipeline::isAvailable() const
+{
+    return !d->m_workers.isEmpty();
+}
+
+int WindowCapturePipeline::workerCount() const
+{
+    return d->m_workers.count();
+}
+
+void WindowCapturePipeline::capture(unsigned int windowId, const QSize& requestedSize,
+                                    int priority, bool smooth)
+{
+    QMutexLocker locker(&d->m_mutex);
+
+    for (int i = 0; i < d->m_jobs.count(); i++) {
+        if (d->m_jobs.at(i).windowId == windowId) {
+            priority = qMax(priority, d->m_jobs.at(i).priority);
+            d->m_jobs.removeAt(i);
+            break;
+        }
+    }
+
+    CaptureJob job;
+    job.windowId = windowId;
+    job.requestedSize = requestedSize;
+    job.priority = priority;
+    job.smooth = smooth;
+
+    /* Insert after all the jobs of the same or higher priority */
+    int position = 0;
+    while (position < d->m_jobs.count() && d->m_jobs.at(position).priority >= priority) {
+        position++;
+    }
+    d->m_jobs.insert(position, job);
+    d->m_jobAvailable.wakeOne();
+}
+
+/* Called from the worker threads. The signal is emitted from the thread of
+   the pipeline, so that receivers connected directly (QSignalSpy for
+   instance) are never called from a worker. */
+void WindowCapturePipeline::deliver(unsigned int windowId, const QImage& image)
+{
+    QMetaObject::invokeMethod(this, "emitCaptured", Qt::QueuedConnection,
+                              Q_ARG(unsigned int, windowId), Q_ARG(QImage, image));
+}
+
+void WindowCapturePipeline::emitCaptured(unsigned int windowId, const QImage& image)
+{
+    Q_EMIT captured(windowId, image);
+}
+
+#include "windowcapturepipeline.moc"
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWCAPTUREPIPELINE_H
+#define WINDOWCAPTUREPIPELINE_H
+
+// Qt
+#include <QObject>
+#include <QImage>
+#include <QSize>
+
+class CaptureWorker;
+struct WindowCapturePipelinePrivate;
+
+/**
+ * Captures windows in the background, on a pool of worker threads each
+ * owning its own X connection, so that reading big windows does not block
+ * the GUI thread.
+ *
+ * Pending captures are served by decreasing priority, then in the order they
+ * were requested. Results are delivered through the captured() signal, in
+ * the thread of the pipeline, as soon as each of them is ready.
+ */
+class WindowCapturePipeline : public QObject
+{
+Q_OBJECT
+public:
+    /**
+     * Creates workerCount workers, or one per core (up to 4) if workerCount
+     * is 0.
+     */
+    explicit WindowCapturePipeline(int workerCount = 0, QObject* parent = 0);
+    ~WindowCapturePipeline();
+
+    /**
+     * Returns false if no worker could connect to the X server, in which
+     * case captures have to be done synchronously.
+     */
+    bool isAvailable() const;
+    int workerCount() const;
+
+    /**
+     * Schedules a capture of the window, downscaled to requestedSize if valid
+     * and smaller than the window. If a capture of the same window is already
+     * pending it's updated instead.
+     */
+    void capture(unsigned int windowId, const QSize& requestedSize, int priority, bool smooth);
+
+Q_SIGNALS:
+    /**
+     * image is null if the window could not be captured (for example because
+     * it got unmapped meanwhile).
+     */
+    void captured(unsigned int windowId, const QImage& image);
+
+private Q_SLOTS:
+    void emitCaptured(unsigned int windowId, const QImage& image);
+
+private:
+    void deliver(unsigned int windowId, const QImage& image);
+
+    WindowCapturePipelinePrivate* const d;
+    friend class CaptureWorker;
+};
+
+#endif // WINDOWCAPTUREPIPELINE_H
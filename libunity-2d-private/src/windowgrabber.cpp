@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "windowgrabber.h"
+
+// Local
+#include "shmimagepool.h"
+#include <debug_p.h>
+
+// Qt
+#include <QX11Info>
+#include <QPainter>
+#include <QPixmap>
+
+// X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+
+struct WindowGrabberPrivate
+{
+    WindowGrabberPrivate(Display* display)
+    : m_display(display)
+    , m_shmPool(display)
+    , m_supportsRender(false)
+    {}
+
+    Display* m_display;
+    ShmImagePool m_shmPool;
+    bool m_supportsRender;
+};
+
+static bool copyXImage(XImage* xImage, const QPoint& offset, QImage* destination)
+{
+    bool hostIsLsb = (QSysInfo::ByteOrder == QSysInfo::LittleEndian);
+    if (xImage->bits_per_pixel != 32
+        || xImage->byte_order != (hostIsLsb ? LSBFirst : MSBFirst)
+        || xImage->red_mask != 0xff0000 || xImage->blue_mask != 0xff) {
+        return false;
+    }
+
+    /* Depth 24 visuals leave the top byte undefined, while Qt's RGB32
+       format expects it to be 0xff */
+    bool opaque = (destination->format() == QImage::Format_RGB32);
+    for (int y = 0; y < xImage->height; y++) {
+        const uint* source = reinterpret_cast<const uint*>(xImage->data + y * xImage->bytes_per_line);
+        uint* line = reinterpret_cast<uint*>(destination->scanLine(offset.y() + y)) + offset.x();
+        if (opaque) {
+            for (int x = 0; x < xImage->width; x++) {
+                line[x] = source[x] | 0xff000000;
+            }
+        } else {
+            memcpy(line, source, xImage->width * sizeof(uint));
+        }
+    }
+    return true;
+}
+
+WindowGrabber::WindowGrabber(Display* display)
+: d(new WindowGrabberPrivate(display))
+{
+    int eventBase, errorBase;
+    d->m_supportsRender = XRenderQueryExtension(display, &eventBase, &errorBase);
+}
+
+WindowGrabber::~WindowGrabber()
+{
+    delete d;
+}
+
+Display* WindowGrabber::display() const
+{
+    return d->m_display;
+}
+
+bool WindowGrabber::supportsRender() const
+{
+    return d->m_supportsRender;
+}
+
+QImage WindowGrabber::grabArea(unsigned long windowId, const QRect& area, int factor,
+                               bool smooth)
+{
+    XWindowAttributes attributes;
+    if (XGetWindowAttributes(d->m_display, windowId, &attributes) == 0
+        || attributes.map_state != IsViewable) {
+        return QImage();
+    }
+
+    QSize windowSize(attributes.width, attributes.height);
+    QRect windowArea = area & QRect(QPoint(0, 0), windowSize);
+    if (windowArea.isEmpty() || factor < 1) {
+        return QImage();
+    }
+
+    QSize scaledWindowSize(qMax(1, windowSize.width() / factor),
+                           qMax(1, windowSize.height() / factor));
+    QRect scaledArea = QRect(windowArea.x() / factor, windowArea.y() / factor,
+                             qMax(1, windowArea.width() / factor),
+                             qMax(1, windowArea.height() / factor))
+                       & QRect(QPoint(0, 0), scaledWindowSize);
+    unsigned long visualId = XVisualIDFromVisual(attributes.visual);
+    XRenderPictFormat* format = d->m_supportsRender ?
+        XRenderFindVisualFormat(d->m_display, attributes.visual) : NULL;
+
+    if (factor == 1 || format == NULL) {
+        QImage image = createImage(windowSize, attributes.depth);
+        if (!readArea(windowId, visualId, attributes.depth, windowArea, &image)) {
+            return QImage();
+        }
+        image = image.copy(windowArea);
+        if (factor == 1) {
+            return image;
+        }
+        return image.scaled(scaledArea.size(), Qt::IgnoreAspectRatio,
+                            smooth ? Qt::SmoothTransformation : Qt::FastTransformation);
+    }
+
+    XRenderPictureAttributes pictureAttributes;
+    pictureAttributes.subwindow_mode = IncludeInferiors;
+    Picture source = XRenderCreatePicture(d->m_display, windowId, format,
+                                          CPSubwindowMode, &pictureAttributes);
+    Pixmap scaledPixmap = XCreatePixmap(d->m_display, windowId, scaledArea.width(),
+                                        scaledArea.height(), attributes.depth);
+    Picture destination = XRenderCreatePicture(d->m_display, scaledPixmap, format, 0, NULL);
+
+    renderScaledArea(source, destination, windowSize, scaledWindowSize, scaledArea, smooth,
+                     scaledArea.topLeft());
+    QImage image = createImage(scaledArea.size(), attributes.depth);
+    bool read = readArea(scaledPixmap, visualId, attributes.depth, image.rect(), &image);
+
+    XRenderFreePicture(d->m_display, destination);
+    XFreePixmap(d->m_display, scaledPixmap);
+    XRenderFreePicture(d->m_display, source);
+
+    return read ? image : QImage();
+}
+
+QImage WindowGrabber::createImage(const QSize& size, int depth)
+{
+    return QImage(size, (depth == 32) ? QImage::Format_ARGB32_Premultiplied
+                                      : QImage::Format_RGB32);
+}
+
+QSize WindowGrabber::scaledSize(const QSize& windowSize, const QSize& requestedSize) const
+{
+    /* Upscaling is left to the caller as it would only increase the
+       transfer size */
+    if (d->m_supportsRender && !requestedSize.isEmpty()
+        && requestedSize.width() <= windowSize.width()
+        && requestedSize.height() <= windowSize.height()) {
+        return requestedSize;
+    }
+    return windowSize;
+}
+
+bool WindowGrabber::readArea(unsigned long drawable, unsigned long visualId, int depth,
+                             const QRect& rect, QImage* image)
+{
+    /* Prefer MIT-SHM when available, so that the pixels do not go through
+       the X socket. This matters a lot for big windows and the root window. */
+    XImage* shmImage = d->m_shmPool.getImage(drawable, visualId, depth, rect);
+    if (shmImage != NULL && copyXImage(shmImage, rect.topLeft(), image)) {
+        return true;
+    }
+
+    XImage* xImage = XGetImage(d->m_display, drawable,
+                               rect.x(), rect.y(), rect.width(), rect.height(),
+                               AllPlanes, ZPixmap);
+    if (xImage == NULL) {
+        /* The window most likely got unmapped or destroyed meanwhile */
+        return false;
+    }
+
+    bool copied = copyXImage(xImage, rect.topLeft(), image);
+    XDestroyImage(xImage);
+    if (copied || d->m_display != QX11Info::display()) {
+        return copied;
+    }
+
+    /* Unusual visual: let Qt deal with the conversion. This is only possible
+       on the connection of Qt itself. */
+    try {
+        QImage area = QPixmap::fromX11Pixmap(drawable).copy(rect).toImage();
+        QPainter painter(image);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(rect.topLeft(), area);
+    } catch (std::bad_alloc) {
+        return false;
+    }
+    return true;
+}
+
+void WindowGrabber::renderScaledArea(unsigned long sourcePicture, unsigned long destinationPicture,
+                                     const QSize& windowSize, const QSize& scaledSize,
+                                     const QRect& rect, bool smooth,
+                                     const QPoint& destinationOffset)
+{
+    /* The transform maps destination coordinates to source coordinates.
+       It's set every time since the window may have been resized. */
+    XTransform transform = {{
+        { XDoubleToFixed(qreal(windowSize.width()) / scaledSize.width()), 0, 0 },
+        { 0, XDoubleToFixed(qreal(windowSize.height()) / scaledSize.height()), 0 },
+        { 0, 0, XDoubleToFixed(1.0) }
+    }};
+    XRenderSetPictureTransform(d->m_display, sourcePicture, &transform);
+    XRenderSetPictureFilter(d->m_display, sourcePicture,
+                            smooth ? FilterBilinear : FilterNearest, NULL, 0);
+
+    XRenderComposite(d->m_display, PictOpSrc, sourcePicture, None, destinationPicture,
+                     rect.x(), rect.y(), 0, 0,
+                     rect.x() - destinationOffset.x(), rect.y() - destinationOffset.y(),
+                     rect.width(), rect.height());
+}
+
+QImage WindowGrabber::grab(unsigned long windowId, const QSize& requestedSize, bool smooth)
+{
+    XWindowAttributes attributes;
+    if (XGetWindowAttributes(d->m_display, windowId, &attributes) == 0
+        || attributes.map_state != IsViewable) {
+        return QImage();
+    }
+
+    QSize windowSize(attributes.width, attributes.height);
+    QSize targetSize = scaledSize(windowSize, requestedSize);
+    unsigned long visualId = XVisualIDFromVisual(attributes.visual);
+    QImage image = createImage(targetSize, attributes.depth);
+
+    if (targetSize == windowSize) {
+        bool read = readArea(windowId, visualId, attributes.depth, image.rect(), &image);
+        return read ? image : QImage();
+    }
+
+    XRenderPictFormat* format = XRenderFindVisualFormat(d->m_display, attributes.visual);
+    if (format == NULL) {
+        return QImage();
+    }
+    XRenderPictureAttributes pictureAttributes;
+    pictureAttributes.subwindow_mode = IncludeInferiors;
+    Picture source = XRenderCreatePicture(d->m_display, windowId, format,
+                                          CPSubwindowMode, &pictureAttributes);
+    Pixmap scaledPixmap = XCreatePixmap(d->m_display, windowId, targetSize.width(),
+                                        targetSize.height(), attributes.depth);
+    Picture destination = XRenderCreatePicture(d->m_display, scaledPixmap, format, 0, NULL);
+
+    renderScaledArea(source, destination, windowSize, targetSize, image.rect(), smooth);
+    bool read = readArea(scaledPixmap, visualId, attributes.depth, image.rect(), &image);
+
+    XRenderFreePicture(d->m_display, destination);
+    XFreePixmap(d->m_display, scaledPixmap);
+    XRenderFreePicture(d->m_display, source);
+
+    return read ? image : QImage();
+}
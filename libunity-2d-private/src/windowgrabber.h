@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWGRABBER_H
+#define WINDOWGRABBER_H
+
+// Qt
+#include <QImage>
+#include <QRect>
+#include <QSize>
+
+typedef struct _XDisplay Display;
+
+struct WindowGrabberPrivate;
+
+/**
+ * Low level helpers to read the contents of windows into QImages, on a
+ * given X connection.
+ *
+ * Reads go through MIT-SHM when possible (see ShmImagePool) and fall back
+ * to XGetImage. Downscaling is done by the X server with XRender.
+ *
+ * A WindowGrabber must only be used from the thread owning its connection.
+ */
+class WindowGrabber
+{
+public:
+    explicit WindowGrabber(Display* display);
+    ~WindowGrabber();
+
+    Display* display() const;
+    bool supportsRender() const;
+
+    /**
+     * Returns the size at which a window of size windowSize should be read
+     * when an image of size requestedSize is requested: requestedSize if the
+     * window can be downscaled to it server side, windowSize otherwise.
+     */
+    QSize scaledSize(const QSize& windowSize, const QSize& requestedSize) const;
+
+    /**
+     * Reads rect of drawable into image, at the same position. The depth and
+     * visual of the drawable must be passed.
+     */
+    bool readArea(unsigned long drawable, unsigned long visualId, int depth,
+                  const QRect& rect, QImage* image);
+
+    /**
+     * Renders rect of the downscaled window by downscaling sourcePicture from
+     * windowSize to scaledSize. It is rendered at the same position in
+     * destinationPicture, minus destinationOffset.
+     */
+    void renderScaledArea(unsigned long sourcePicture, unsigned long destinationPicture,
+                          const QSize& windowSize, const QSize& scaledSize,
+                          const QRect& rect, bool smooth,
+                          const QPoint& destinationOffset = QPoint());
+
+    /**
+     * Reads the whole window in one go, downscaled if requestedSize is
+     * smaller than it. Returns a null image if the window is not viewable.
+     */
+    QImage grab(unsigned long windowId, const QSize& requestedSize, bool smooth);
+
+    /**
+     * Reads area of the window, downscaled by factor. When possible the
+     * downscaling is done by the X server, so that only the pixels of the
+     * downscaled area are transferred. Returns a null image if the window
+     * is not viewable.
+     */
+    QImage grabArea(unsigned long windowId, const QRect& area, int factor, bool smooth);
+
+    /**
+     * Returns an image suitable to receive the contents of a window of the
+     * given depth.
+     */
+    static QImage createImage(const QSize& size, int depth);
+
+private:
+    Q_DISABLE_COPY(WindowGrabber)
+    WindowGrabberPrivate* const d;
+};
+
+#endif // WINDOWGRABBER_H
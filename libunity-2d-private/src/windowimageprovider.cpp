@@ -18,18 +18,36 @@
 #include <QPixmap>
 #include <QPainter>
 #include <QImage>
+#include <QRegion>
+#include <QTransform>
 
 #include "windowimageprovider.h"
+#include "windowthumbnailcache.h"
 #include <debug_p.h>
 
+#include "qconf.h"
+
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/shape.h>
 
+static const char* SPREAD_DCONF_SCHEMA = "com.canonical.Unity2d.Spread";
+
+/* The setup of the X server and of the thumbnail cache is process wide, and
+   done by the first provider created only */
+static bool sInitialized = false;
+static bool sX11SupportsShape = false;
+
 WindowImageProvider::WindowImageProvider() :
     QDeclarativeImageProvider(QDeclarativeImageProvider::Image), m_x11supportsShape(false)
 {
+    if (sInitialized) {
+        m_x11supportsShape = sX11SupportsShape;
+        return;
+    }
+    sInitialized = true;
+
     /* Always activate composite, so we can capture windows that are partially obscured
        Ideally we want to activate it only when QX11Info::isCompositingManagerRunning()
        is false, but in my experience it is not reliable at all.
@@ -41,8 +59,19 @@ WindowImageProvider::WindowImageProvider() :
     activateComposite();
 
     int event_base, error_base;
-    m_x11supportsShape = XShapeQueryExtension(QX11Info::display(),
-                                              &event_base, &error_base);
+    sX11SupportsShape = XShapeQueryExtension(QX11Info::display(),
+                                             &event_base, &error_base);
+    m_x11supportsShape = sX11SupportsShape;
+
+    QConf conf(SPREAD_DCONF_SCHEMA);
+    QString filter = conf.property("thumbnailFilter").toString();
+    WindowThumbnailCache* cache = WindowThumbnailCache::instance();
+    cache->setScaleFilter(filter == "nearest" ?
+        WindowThumbnailCache::Nearest : WindowThumbnailCache::Bilinear);
+    int cacheSize = conf.property("thumbnailCacheSize").toInt();
+    if (cacheSize > 0) {
+        cache->setMemoryBudget(qint64(cacheSize) * 1024 * 1024);
+    }
 }
 
 WindowImageProvider::~WindowImageProvider()
@@ -99,10 +128,10 @@ QImage WindowImageProvider::requestImage(const QString &id,
                                               QSize *size,
                                               const QSize &requestedSize)
 {
-    /* Throw away the part of the id after the @ (if any) since it's just a timestamp
-       added to force the QML image cache to request to this image provider
-       a new image instead of re-using the old. See SpreadWindow.qml for more
-       details on the problem. */
+    /* Throw away the part of the id after the @ (if any) since it's just a
+       thumbnail generation (or a timestamp) added to force the QML image cache
+       to request to this image provider a new image instead of re-using the old.
+       See Window.qml for more details on the problem. */
     int atPos = id.indexOf('@');
     QString windowIds = (atPos == -1) ? id : id.left(atPos);
 
@@ -117,8 +146,36 @@ QImage WindowImageProvider::requestImage(const QString &id,
         frameId = QX11Info::appRootWindow();
     }
 
-    QImage image;
-    QPixmap pixmap = getWindowPixmap(frameId, contentId);
+    /* Windows are served from the thumbnail cache, which only reads back
+       from the X server the parts of the window that got damaged since the
+       last request, already downscaled to requestedSize if smaller. It also
+       keeps the last contents of windows that got unmapped, so the capture
+       done by metacity is only needed for windows it never saw viewable.
+       Windows are first captured in the background, and the cache bumps
+       their generation (see WindowInfo::thumbnailGeneration) once done.
+       The root window is still read synchronously as its consumers use a
+       timestamp instead of a generation. */
+    WindowThumbnailCache* cache = WindowThumbnailCache::instance();
+    bool isRoot = (frameId == QX11Info::appRootWindow());
+    if (!isRoot) {
+        cache->setAsynchronousCaptureEnabled(true);
+    }
+    QImage image = cache->image(frameId, requestedSize,
+                                isRoot ? WindowThumbnailCache::Synchronous
+                                       : WindowThumbnailCache::Asynchronous);
+    if (image.isNull() && cache->isCapturePending(frameId)) {
+        /* Do not block on the metacity fallback below, the consumer will
+           request the image again when it's ready */
+        return image;
+    }
+    if (!image.isNull() && !isRoot) {
+        image = shapeWindowImage(image, frameId, cache->windowSize(frameId));
+    }
+
+    QPixmap pixmap;
+    if (image.isNull()) {
+        pixmap = getWindowPixmap(frameId, contentId);
+    }
     if (!pixmap.isNull()) {
         image = convertWindowPixmap(pixmap, frameId);
         if (image.isNull()) {
@@ -133,7 +190,7 @@ QImage WindowImageProvider::requestImage(const QString &id,
     }
 
     if (!image.isNull()) {
-        if (requestedSize.isValid()) {
+        if (requestedSize.isValid() && image.size() != requestedSize) {
             image = image.scaled(requestedSize);
         }
         size->setWidth(image.width());
@@ -167,58 +224,101 @@ QPixmap WindowImageProvider::getWindowPixmap(Window frameWindowId,
     }
 }
 
-/* All the exception checks in this method are due to the fact that
-   the windowPixmap is an X11 Drawable tied to a window. When we called
-   this function the drawable was valid since the window was mapped, however
-   there's no guarantee it will stay that way.
-   All the operations we do here involve at some point converting the pixmap
-   into a QImage (since we use the rester paint engine). This conversion will
-   throw std::bad_alloc if the drawable is not valid, so we need to catch it.
-*/
+/* Returns the bounding shape of the window, or an empty region if the
+   Shape extension is not supported or the shape could not be retrieved.
+   An empty shape is taken as no shape at all (see convertWindowPixmap). */
+QRegion WindowImageProvider::windowShape(Window frameWindowId)
+{
+    if (!m_x11supportsShape) {
+        return QRegion();
+    }
+
+    int rectangle_count, rectangle_order;
+    XRectangle *rectangles = XShapeGetRectangles(QX11Info::display(),
+                                                 frameWindowId,
+                                                 ShapeBounding,
+                                                 &rectangle_count,
+                                                 &rectangle_order);
+    QRegion shape;
+    for (int i = 0; i < rectangle_count; i++) {
+        XRectangle r = rectangles[i];
+        shape += QRect(r.x, r.y, r.width, r.height);
+    }
+    if (rectangles != NULL) {
+        XFree(rectangles);
+    }
+    return shape;
+}
+
+/* Clears the parts of the image that fall outside of shape, in one pass.
+   An empty shape means that the window is not shaped. */
+static QImage clipToShape(const QImage& image, const QRegion& shape)
+{
+    if (shape.isEmpty()) {
+        return image;
+    }
+
+    QRegion outside = QRegion(image.rect()) - shape;
+    if (outside.isEmpty()) {
+        return image;
+    }
+
+    QImage result = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&result);
+    painter.setCompositionMode(QPainter::CompositionMode_Clear);
+    painter.setClipRegion(outside);
+    painter.fillRect(result.rect(), Qt::transparent);
+    return result;
+}
+
+/* Clears the parts of the image that fall outside of the bounding shape of
+   the window. Unlike convertWindowPixmap this does not need to transfer the
+   window contents again, only its shape rectangles.
+   The image may be a downscaled version of a window of size windowSize. */
+QImage WindowImageProvider::shapeWindowImage(const QImage& image, Window frameWindowId,
+                                             const QSize& windowSize)
+{
+    QRegion shape = windowShape(frameWindowId);
+    if (!shape.isEmpty() && windowSize.isValid() && windowSize != image.size()) {
+        shape = QTransform::fromScale(qreal(image.width()) / windowSize.width(),
+                                      qreal(image.height()) / windowSize.height()).map(shape);
+    }
+    return clipToShape(image, shape);
+}
+
 QImage WindowImageProvider::convertWindowPixmap(QPixmap windowPixmap,
                                                 Window frameWindowId)
 {
-    if (m_x11supportsShape) {
-        /* The borders of the window may be irregularly shaped.
-           To capture this correctly we need to ask the Shape extension
-           to decompose the non-transparent window are into rectangles,
-           then copy each of them from the screenshot to our
-           destination image (which is entirely transparent initally) */
-        XRectangle *rectangles;
-        int rectangle_count, rectangle_order;
-        rectangles = XShapeGetRectangles (QX11Info::display(),
-                                          frameWindowId,
-                                          ShapeBounding,
-                                          &rectangle_count,
-                                          &rectangle_order);
-
-        QImage result(windowPixmap.size(), QImage::Format_ARGB32_Premultiplied);
-        result.fill(Qt::transparent);
-        QPainter painter(&result);
-
-        for (int i = 0; i < rectangle_count; i++) {
-            XRectangle r = rectangles[i];
-            try {
-                /* Since we're using the raster paint engine, this will internally
-                   call QX11PixmapData::toImage on windowPixmap to be able to
-                   draw it on the QImage */
-                painter.drawPixmap(QPointF(r.x, r.y), windowPixmap,
-                                   QRectF(r.x, r.y, r.width, r.height));
-            } catch (std::bad_alloc) {
-                return QImage();
-            }
-        }
+    /* The borders of the window may be irregularly shaped, in which case
+       the parts of the screenshot outside of them are made transparent */
+    return convertWindowPixmap(windowPixmap, windowShape(frameWindowId));
+}
 
-        painter.end();
-        XFree(rectangles);
-        return result;
-    } else {
-        try {
-            return windowPixmap.toImage();
-        } catch (std::bad_alloc) {
-            return QImage();
-        }
+/* The windowPixmap is an X11 Drawable tied to a window. When we called
+   this function the drawable was valid since the window was mapped, however
+   there's no guarantee it will stay that way.
+   Converting the pixmap into a QImage will throw std::bad_alloc if the
+   drawable is not valid, so we need to catch it.
+   The pixmap is transferred exactly once whatever the number of rectangles
+   composing the shape: painting it rectangle by rectangle would make the
+   raster paint engine call QX11PixmapData::toImage for each of them.
+*/
+QImage WindowImageProvider::convertWindowPixmap(const QPixmap& windowPixmap,
+                                                const QRegion& shape,
+                                                PixmapReader reader)
+{
+    QImage image;
+    try {
+        image = reader(windowPixmap);
+    } catch (std::bad_alloc) {
+        return QImage();
     }
+    return clipToShape(image, shape);
+}
+
+QImage WindowImageProvider::readPixmap(const QPixmap& pixmap)
+{
+    return pixmap.toImage();
 }
 
 /*! Tries to ask the X Composite extension (if supported) to redirect all
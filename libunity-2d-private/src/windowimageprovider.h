@@ -19,6 +19,7 @@
 
 #include <QDeclarativeImageProvider>
 #include <QImage>
+#include <QRegion>
 #include <QSize>
 
 typedef unsigned long Window;
@@ -31,9 +32,28 @@ public:
     virtual QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
     static void activateComposite();
 
+    /* Reads the contents of a pixmap from the X server */
+    typedef QImage (*PixmapReader)(const QPixmap& pixmap);
+    static QImage readPixmap(const QPixmap& pixmap);
+
+    /**
+     * Converts a screenshot of a window to an image, making the parts outside
+     * of shape transparent. The pixmap is read only once, with reader.
+     *
+     * An empty shape means the window is not shaped: the X server reports
+     * the bounding rectangle of unshaped windows, so no rectangle at all
+     * only happens when the shape could not be retrieved, and the window
+     * is then shown whole rather than not at all.
+     */
+    static QImage convertWindowPixmap(const QPixmap& windowPixmap, const QRegion& shape,
+                                      PixmapReader reader = readPixmap);
+
 private:
     QPixmap getWindowPixmap(Window frameWindowId, Window contentWindowId);
     QImage convertWindowPixmap(QPixmap windowPixmap, Window frameWindowId);
+    QImage shapeWindowImage(const QImage& image, Window frameWindowId,
+                            const QSize& windowSize);
+    QRegion windowShape(Window frameWindowId);
 
     bool m_x11supportsShape;
 };
@@ -23,6 +23,8 @@
 #include "bamf-window.h"
 
 #include "windowinfo.h"
+#include "windowstackingindex.h"
+#include "windowthumbnailcache.h"
 #include <X11/Xlib.h>
 #include <QX11Info>
 
@@ -35,6 +37,12 @@ WindowInfo::WindowInfo(unsigned int contentXid, QObject *parent) :
 
 WindowInfo::~WindowInfo()
 {
+    if (m_decoratedXid != 0) {
+        WindowThumbnailCache::instance()->unwatch(m_decoratedXid, this);
+    }
+    if (m_contentXid != 0) {
+        WindowStackingIndex::instance()->unwatch(m_contentXid, this);
+    }
     g_signal_handlers_disconnect_by_func(m_wnckWindow, gpointer(WindowInfo::onWorkspaceChanged), this);
 }
 
@@ -132,6 +140,14 @@ void WindowInfo::setContentXid(unsigned int contentXid)
     if (m_wnckWindow != NULL) {
         g_signal_handlers_disconnect_by_func(m_wnckWindow, gpointer(WindowInfo::onWorkspaceChanged), this);
     }
+    WindowThumbnailCache* cache = WindowThumbnailCache::instance();
+    if (m_decoratedXid != 0) {
+        cache->unwatch(m_decoratedXid, this);
+    }
+    WindowStackingIndex* stackingIndex = WindowStackingIndex::instance();
+    if (m_contentXid != 0) {
+        stackingIndex->unwatch(m_contentXid, this);
+    }
 
     /* Set member variables and emit changed signals */
     m_bamfApplication = bamfApplication;
@@ -142,6 +158,9 @@ void WindowInfo::setContentXid(unsigned int contentXid)
 
     g_signal_connect(G_OBJECT(m_wnckWindow), "workspace-changed",
                      G_CALLBACK(WindowInfo::onWorkspaceChanged), this);
+    /* Only the changes of this window are delivered, see WindowReceivers */
+    cache->watch(m_decoratedXid, this, "updateThumbnailGeneration");
+    stackingIndex->watch(m_contentXid, this, "updateZ");
 
     Q_EMIT contentXidChanged(m_contentXid);
     Q_EMIT decoratedXidChanged(m_decoratedXid);
@@ -153,6 +172,7 @@ void WindowInfo::setContentXid(unsigned int contentXid)
     Q_EMIT iconChanged(icon());
     Q_EMIT desktopFileChanged(desktopFile());
     Q_EMIT workspaceChanged(workspace());
+    Q_EMIT thumbnailGenerationChanged(thumbnailGeneration());
 }
 
 void WindowInfo::setWorkspace(int workspaceNumber)
@@ -178,18 +198,14 @@ QSize WindowInfo::size() const
 
 unsigned int WindowInfo::z() const
 {
-    int z = 0;
-    GList *stack = wnck_screen_get_windows_stacked(wnck_screen_get_default());
-    GList *cur = stack;
-    while (cur) {
-        z++;
-        WnckWindow *window = (WnckWindow*) cur->data;
-        if (wnck_window_get_xid(window) == m_contentXid) {
-            break;
-        }
-        cur = g_list_next(cur);
-    }
-    return z;
+    return WindowStackingIndex::instance()->z(m_contentXid);
+}
+
+void WindowInfo::updateZ(unsigned int xid, unsigned int z)
+{
+    Q_UNUSED(xid);
+
+    Q_EMIT zChanged(z);
 }
 
 QString WindowInfo::title() const
@@ -239,6 +255,23 @@ int WindowInfo::workspace() const
     return -1;
 }
 
+/* This changes every time the contents of the decorated window change, and
+   is meant to be used in the image://window/ source of the window screenshot
+   instead of a timestamp, so that the image is requested again only if needed.
+   See WindowThumbnailCache for details.
+*/
+unsigned int WindowInfo::thumbnailGeneration() const
+{
+    return WindowThumbnailCache::instance()->generation(m_decoratedXid);
+}
+
+void WindowInfo::updateThumbnailGeneration(unsigned int windowId, unsigned int generation)
+{
+    Q_UNUSED(windowId);
+
+    Q_EMIT thumbnailGenerationChanged(generation);
+}
+
 void WindowInfo::activate()
 {
     showWindow(m_wnckWindow);
@@ -259,14 +292,31 @@ void WindowInfo::updateGeometry()
     Q_EMIT sizeChanged(m_size);
 }
 
-void WindowInfo::showWindow(WnckWindow* window)
+bool WindowInfo::refresh()
 {
-    wnck_window_activate(window, CurrentTime);
+    if (m_wnckWindow == NULL) {
+        return false;
+    }
+
+    /* WNCK follows the ConfigureNotify events of the frames itself */
+    int x, y, w, h;
+    wnck_window_get_geometry(m_wnckWindow, &x, &y, &w, &h);
+    if (QPoint(x, y) != m_position) {
+        m_position = QPoint(x, y);
+        Q_EMIT positionChanged(m_position);
+    }
+    bool resized = (QSize(w, h) != m_size);
+    if (resized) {
+        m_size = QSize(w, h);
+        Q_EMIT sizeChanged(m_size);
+    }
+    Q_EMIT titleChanged(title());
+    return resized;
 }
 
-bool WindowInfo::isSameBamfWindow(BamfWindow *other)
+void WindowInfo::showWindow(WnckWindow* window)
 {
-    return (m_bamfWindow == other);
+    wnck_window_activate(window, CurrentTime);
 }
 
 void WindowInfo::onWorkspaceChanged(WnckWindow *window, gpointer user_data)
@@ -46,7 +46,7 @@ class BamfView;
 typedef struct _WnckWindow WnckWindow;
 typedef void* gpointer;
 
-/* FIXME: position, size, z, title and icon values are not updated real time */
+/* FIXME: position, size, title and icon values are not updated real time */
 class WindowInfo : public QObject
 {
     Q_OBJECT
@@ -62,6 +62,8 @@ class WindowInfo : public QObject
     Q_PROPERTY(unsigned int decoratedXid READ decoratedXid NOTIFY decoratedXidChanged)
     Q_PROPERTY(QString desktopFile READ desktopFile NOTIFY desktopFileChanged)
     Q_PROPERTY(int workspace READ workspace WRITE setWorkspace NOTIFY workspaceChanged)
+    Q_PROPERTY(unsigned int thumbnailGeneration READ thumbnailGeneration
+                                                NOTIFY thumbnailGenerationChanged)
 
 public:
     explicit WindowInfo(unsigned int contentXid = 0, QObject *parent = 0);
@@ -77,6 +79,7 @@ public:
     QString icon() const;
     QString desktopFile() const;
     int workspace() const;
+    unsigned int thumbnailGeneration() const;
 
     /* setters */
     void setContentXid(unsigned int contentXid);
@@ -84,6 +87,10 @@ public:
 
     Q_INVOKABLE void activate();
 
+    /* Reads the geometry and title of the window again, see the FIXME
+       above. Returns whether the size changed. */
+    bool refresh();
+
     static void showWindow(WnckWindow* window);
 
     enum RoleNames {
@@ -102,6 +109,11 @@ Q_SIGNALS:
     void iconChanged(QString icon);
     void desktopFileChanged(QString desktopFile);
     void workspaceChanged(int workspace);
+    void thumbnailGenerationChanged(unsigned int thumbnailGeneration);
+
+private Q_SLOTS:
+    void updateThumbnailGeneration(unsigned int windowId, unsigned int generation);
+    void updateZ(unsigned int xid, unsigned int z);
 
 private:
     void updateGeometry();
@@ -109,7 +121,6 @@ private:
     BamfWindow* getBamfWindowForApplication(BamfApplication *application, unsigned int xid);
     WnckWindow* getWnckWindowForXid(unsigned int xid);
     unsigned int findTopmostAncestor(unsigned int xid);
-    bool isSameBamfWindow(BamfWindow *other);
     static void onWorkspaceChanged(WnckWindow *window, gpointer user_data);
 
 private:
@@ -120,10 +131,6 @@ private:
     unsigned int m_decoratedXid;
     QPoint m_position;
     QSize m_size;
-
-/* This is needed so that WindowsList can access isSameBamfWindow.
-   Check WindowInfo::removeWindow for an explanation of why. */
-friend class WindowsList;
 };
 
 QML_DECLARE_TYPE(WindowInfo)
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "windowreceivers.h"
+
+void WindowReceivers::add(unsigned int xid, QObject *receiver, const char *member)
+{
+    Receiver entry;
+    entry.object = receiver;
+    entry.member = member;
+    m_receivers.insert(xid, entry);
+}
+
+void WindowReceivers::remove(unsigned int xid, QObject *receiver)
+{
+    QMultiHash<unsigned int, Receiver>::iterator it = m_receivers.find(xid);
+    while (it != m_receivers.end() && it.key() == xid) {
+        if (it.value().object.isNull()) {
+            /* Deleted without being removed */
+            it = m_receivers.erase(it);
+        } else if (it.value().object == receiver) {
+            m_receivers.erase(it);
+            return;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void WindowReceivers::notify(unsigned int xid, QGenericArgument val0,
+                             QGenericArgument val1, QGenericArgument val2) const
+{
+    /* Receivers may add or remove receivers when notified */
+    QList<Receiver> receivers = m_receivers.values(xid);
+    Q_FOREACH(const Receiver& receiver, receivers) {
+        if (!receiver.object.isNull()) {
+            QMetaObject::invokeMethod(receiver.object, receiver.member.constData(),
+                                      Qt::DirectConnection, val0, val1, val2);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWRECEIVERS_H
+#define WINDOWRECEIVERS_H
+
+#include <QByteArray>
+#include <QMultiHash>
+#include <QObject>
+#include <QPointer>
+
+/* Receivers of the changes of individual windows, for the process wide
+   indexes that follow all the windows.
+
+   A change is delivered only to the receivers of the window that changed,
+   which costs the same whatever the number of windows followed, instead of
+   being broadcast to every receiver to be filtered by XID. */
+class WindowReceivers
+{
+public:
+    /* member is the name of a slot or invokable method of receiver, called
+       with the arguments passed to notify(). A receiver added n times for
+       a window has to be removed n times. */
+    void add(unsigned int xid, QObject *receiver, const char *member);
+    void remove(unsigned int xid, QObject *receiver);
+
+    void notify(unsigned int xid,
+                QGenericArgument val0 = QGenericArgument(0),
+                QGenericArgument val1 = QGenericArgument(),
+                QGenericArgument val2 = QGenericArgument()) const;
+
+private:
+    struct Receiver
+    {
+        QPointer<QObject> object;
+        QByteArray member;
+    };
+
+    QMultiHash<unsigned int, Receiver> m_receivers;
+};
+
+#endif // WINDOWRECEIVERS_H
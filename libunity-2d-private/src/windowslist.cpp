@@ -14,6 +14,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <libwnck/libwnck.h>
+
 #include <QRegExp>
 #include <QApplication>
 #include <QWidget>
@@ -22,14 +24,30 @@
 #include <debug_p.h>
 #include "windowslist.h"
 #include "windowinfo.h"
+#include "windowthumbnailcache.h"
 
 #include "bamf-matcher.h"
 #include "bamf-window.h"
 #include "bamf-application.h"
 #include "bamf-view.h"
 
+/* Windows on the current workspace are the first ones shown by the spread,
+   so their thumbnails are captured before the others */
+static void updateCapturePriority(WindowInfo *info)
+{
+    int workspace = info->workspace();
+    bool onCurrentWorkspace = (workspace == -2);
+    if (!onCurrentWorkspace) {
+        WnckWorkspace *current = wnck_screen_get_active_workspace(wnck_screen_get_default());
+        onCurrentWorkspace = (current != NULL && workspace == wnck_workspace_get_number(current));
+    }
+    WindowThumbnailCache::instance()->setPriority(info->decoratedXid(), onCurrentWorkspace ? 1 : 0);
+}
+
 WindowsList::WindowsList(QObject *parent) :
-    QAbstractListModel(parent)
+    QAbstractListModel(parent),
+    m_resident(false),
+    m_loaded(false)
 {
     QHash<int, QByteArray> roles;
     roles[WindowInfo::RoleWindowInfo] = "window";
@@ -71,16 +89,27 @@ QVariant WindowsList::data(const QModelIndex &index, int role) const
 
 void WindowsList::load()
 {
+    if (m_resident && m_loaded) {
+        /* The list is already up to date thanks to ViewOpened and
+           ViewClosed, but windows may have been moved or resized since.
+           Proxies computing the layout of the spread from the size of the
+           windows are told about the resized ones. */
+        for (int row = 0; row < m_windows.count(); row++) {
+            if (m_windows.at(row)->refresh()) {
+                QModelIndex resized = index(row);
+                Q_EMIT dataChanged(resized, resized);
+            }
+        }
+        return;
+    }
+
     BamfMatcher &matcher = BamfMatcher::get_default();
-    connect(&matcher, SIGNAL(ViewOpened(BamfView*)), SLOT(addWindow(BamfView*)));
-    connect(&matcher, SIGNAL(ViewClosed(BamfView*)), SLOT(removeWindow(BamfView*)));
+    connect(&matcher, SIGNAL(ViewOpened(BamfView*)), SLOT(addWindow(BamfView*)),
+            Qt::UniqueConnection);
+    connect(&matcher, SIGNAL(ViewClosed(BamfView*)), SLOT(removeWindow(BamfView*)),
+            Qt::UniqueConnection);
 
-    if (m_windows.count() > 0) {
-        beginRemoveRows(QModelIndex(), 0, m_windows.count() - 1);
-        qDeleteAll(m_windows);
-        m_windows.clear();
-        endRemoveRows();
-    }
+    clear();
 
     QList<BamfApplication*> applications;
 
@@ -92,6 +121,8 @@ void WindowsList::load()
 
     /* Add to the list only WindowInfo for windows that are
       'user_visible' according to BAMF */
+    QList<WindowInfo*> infos;
+    QList<BamfWindow*> bamfWindowsAdded;
     Q_FOREACH (BamfApplication* application, applications) {
         if (!application->user_visible()) {
             continue;
@@ -100,24 +131,94 @@ void WindowsList::load()
         BamfWindowList *bamfWindows = application->windows();
         for (int i = 0; i < bamfWindows->size(); i++) {
             BamfWindow* window = bamfWindows->at(i);
-            if (!window->user_visible()) {
+            if (!window->user_visible() || m_windowsByXid.contains(window->xid())) {
                 continue;
             }
 
             WindowInfo *info = new WindowInfo(window->xid());
             connect(info, SIGNAL(workspaceChanged(int)), SLOT(updateWorkspaceRole(int)));
+            updateCapturePriority(info);
+            infos.append(info);
+            bamfWindowsAdded.append(window);
+            m_windowsByXid.insert(window->xid(), info);
+            m_xids.insert(info, window->xid());
+            indexWindow(info);
+        }
+    }
 
-            /* It may seem less efficient to add items one by one instead of adding them
-               to a list and appending the entire list at the end and notify only one
-               size change.
-               However doing it that way for some reason prevents the GridView connected
-               to this model from emitting *any* onAdd signal, and the logic in Spread
-               relies on these signals being reliably emitted. */
-            beginInsertRows(QModelIndex(), m_windows.count(), m_windows.count());
-            m_windows.append(info);
-            endInsertRows();
+    /* All the windows are inserted at once. The GridView of the spread does
+       not emit onAdd for them in that case, which is why its delegates
+       start their add animation from Component.onCompleted instead. */
+    if (!infos.isEmpty()) {
+        beginInsertRows(QModelIndex(), 0, infos.count() - 1);
+        for (int i = 0; i < infos.count(); i++) {
+            m_windowsByBamfWindow.insert(bamfWindowsAdded.at(i), infos.at(i));
+            m_bamfWindows.insert(infos.at(i), bamfWindowsAdded.at(i));
+            m_rows.insert(infos.at(i), i);
         }
+        m_windows = infos;
+        endInsertRows();
     }
+
+    m_loaded = true;
+}
+
+/* Deletes all the windows */
+void WindowsList::clear()
+{
+    if (m_windows.count() > 0) {
+        beginRemoveRows(QModelIndex(), 0, m_windows.count() - 1);
+        qDeleteAll(m_windows);
+        m_windows.clear();
+        m_windowsByBamfWindow.clear();
+        m_windowsByXid.clear();
+        m_bamfWindows.clear();
+        m_xids.clear();
+        m_windowsByDesktopFile.clear();
+        m_windowsByWorkspace.clear();
+        m_workspaces.clear();
+        m_rows.clear();
+        endRemoveRows();
+    }
+}
+
+WindowInfo* WindowsList::windowForXid(unsigned int contentXid) const
+{
+    return m_windowsByXid.value(contentXid);
+}
+
+WindowInfo* WindowsList::at(int row) const
+{
+    return m_windows.at(row);
+}
+
+int WindowsList::rowOf(WindowInfo *window) const
+{
+    return m_rows.value(window, -1);
+}
+
+QList<WindowInfo*> WindowsList::windowsForDesktopFile(const QString &desktopFile) const
+{
+    return m_windowsByDesktopFile.values(desktopFile);
+}
+
+QList<WindowInfo*> WindowsList::windowsOnWorkspace(int workspace) const
+{
+    return m_windowsByWorkspace.values(workspace);
+}
+
+void WindowsList::indexWindow(WindowInfo *window)
+{
+    int workspace = window->workspace();
+    m_windowsByDesktopFile.insert(window->desktopFile(), window);
+    m_windowsByWorkspace.insert(workspace, window);
+    m_workspaces.insert(window, workspace);
+}
+
+void WindowsList::unindexWindow(WindowInfo *window)
+{
+    m_windowsByDesktopFile.remove(window->desktopFile(), window);
+    m_windowsByWorkspace.remove(m_workspaces.take(window), window);
 }
 
 void WindowsList::unload()
@@ -125,11 +226,22 @@ void WindowsList::unload()
     BamfMatcher &matcher = BamfMatcher::get_default();
     matcher.disconnect(this, SLOT(addWindow(BamfView*)));
     matcher.disconnect(this, SLOT(removeWindow(BamfView*)));
+    m_loaded = false;
 
-    beginRemoveRows(QModelIndex(), 0, m_windows.count() - 1);
-    qDeleteAll(m_windows);
-    m_windows.clear();
-    endRemoveRows();
+    clear();
+}
+
+bool WindowsList::isResident() const
+{
+    return m_resident;
+}
+
+void WindowsList::setResident(bool resident)
+{
+    if (resident != m_resident) {
+        m_resident = resident;
+        Q_EMIT residentChanged(resident);
+    }
 }
 
 void WindowsList::addWindow(BamfView *view)
@@ -159,10 +271,21 @@ void WindowsList::addWindow(BamfView *view)
         return;
     }
 
+    if (m_windowsByXid.contains(window->xid())) {
+        return;
+    }
+
     WindowInfo *info = new WindowInfo(window->xid());
     connect(info, SIGNAL(workspaceChanged(int)), SLOT(updateWorkspaceRole(int)));
+    updateCapturePriority(info);
 
     beginInsertRows(QModelIndex(), m_windows.count(), m_windows.count());
+    m_windowsByBamfWindow.insert(window, info);
+    m_windowsByXid.insert(window->xid(), info);
+    m_bamfWindows.insert(info, window);
+    m_xids.insert(info, window->xid());
+    indexWindow(info);
+    m_rows.insert(info, m_windows.count());
     m_windows.append(info);
     endInsertRows();
 }
@@ -181,16 +304,38 @@ void WindowsList::removeWindow(BamfView *view)
        window is already gone. This means that it's not possible to
        retrieve the XID from the BamfWindow to find the window itself
        in the list.
-       To workaround this, we compare directly the BamfWindow pointer
-       to the one in the WindowInfo.
+       To workaround this, the windows are also indexed by their BamfWindow
+       pointer.
     */
-    for (int i = 0; i < m_windows.length(); i++) {
-        if (m_windows.at(i)->isSameBamfWindow(window)) {
-            beginRemoveRows(QModelIndex(), i, i);
-            delete m_windows.takeAt(i);
-            endRemoveRows();
-            return;
-        }
+    WindowInfo *info = m_windowsByBamfWindow.value(window);
+    if (info == NULL) {
+        return;
+    }
+
+    int row = m_rows.value(info);
+    beginRemoveRows(QModelIndex(), row, row);
+    takeRows(row, 1);
+    endRemoveRows();
+    delete info;
+}
+
+/* Removes the windows from the list and the indexes, without deleting them */
+void WindowsList::takeRows(int row, int count)
+{
+    for (int i = row; i < row + count; i++) {
+        WindowInfo *info = m_windows.at(i);
+        m_rows.remove(info);
+        unindexWindow(info);
+        /* Use the XID the window was indexed under: the content XID of the
+           WindowInfo is 0 if it failed to find the window */
+        m_windowsByXid.remove(m_xids.take(info));
+        m_windowsByBamfWindow.remove(m_bamfWindows.take(info));
+    }
+    m_windows.erase(m_windows.begin() + row, m_windows.begin() + row + count);
+
+    /* Only the rows after the removed ones need to be renumbered */
+    for (int i = row; i < m_windows.count(); i++) {
+        m_rows.insert(m_windows.at(i), i);
     }
 }
 
@@ -204,8 +349,11 @@ void WindowsList::updateWorkspaceRole(int workspace)
 
     WindowInfo *window = qobject_cast<WindowInfo*>(sender());
     if (window != NULL) {
-        int row = m_windows.indexOf(window);
+        updateCapturePriority(window);
+        int row = m_rows.value(window, -1);
         if (row != -1) {
+            unindexWindow(window);
+            indexWindow(window);
             QModelIndex changedItem = index(row);
             Q_EMIT dataChanged(changedItem, changedItem);
         }
@@ -220,10 +368,7 @@ bool WindowsList::removeRows(int row, int count, const QModelIndex& parent)
     count = qMin(count, m_windows.count() - row);
 
     beginRemoveRows(parent, row, row + count - 1);
-
-    for (int i = 0; i < count; i++) {
-        m_windows.removeAt(row);
-    }
+    takeRows(row, count);
 
     endRemoveRows();
     return true;
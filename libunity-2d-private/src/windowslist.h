@@ -18,12 +18,14 @@
 #define WINDOWSLIST_H
 
 #include <QAbstractListModel>
+#include <QHash>
 #include <QVariant>
 #include <QObject>
 #include <QtDeclarative/qdeclarative.h>
 
 class WindowInfo;
 class BamfView;
+class BamfWindow;
 
 /* FIXME: this should be update dynamically whenever new windows are opened
    or go away. Both wnck and bamf have signals for this */
@@ -31,6 +33,11 @@ class WindowsList : public QAbstractListModel
 {
     Q_OBJECT
 
+    /* When resident, the list is kept up to date once loaded and load()
+       does not rebuild it anymore, so that it is ready to be shown at
+       any time */
+    Q_PROPERTY(bool resident READ isResident WRITE setResident NOTIFY residentChanged)
+
 public:
     WindowsList(QObject *parent = 0);
     ~WindowsList();
@@ -43,13 +50,51 @@ public:
     Q_INVOKABLE void load();
     Q_INVOKABLE void unload();
 
+    bool isResident() const;
+    void setResident(bool resident);
+
+    /* Returns the window with the given content XID, or NULL if it's not
+       in the list */
+    WindowInfo* windowForXid(unsigned int contentXid) const;
+    WindowInfo* at(int row) const;
+    /* Returns -1 if the window is not in the list */
+    int rowOf(WindowInfo *window) const;
+
+    /* The windows of an application, or on a workspace (-2 for the windows
+       pinned to all workspaces), in no particular order */
+    QList<WindowInfo*> windowsForDesktopFile(const QString &desktopFile) const;
+    QList<WindowInfo*> windowsOnWorkspace(int workspace) const;
+
+Q_SIGNALS:
+    void residentChanged(bool resident);
+
 public Q_SLOTS:
     void addWindow(BamfView *view);
     void removeWindow(BamfView *view);
     void updateWorkspaceRole(int workspace);
 
 protected:
+    void clear();
+    void takeRows(int row, int count);
+    void indexWindow(WindowInfo *window);
+    void unindexWindow(WindowInfo *window);
+
     QList<WindowInfo*> m_windows;
+    /* Indexes on m_windows, so that windows can be found without scanning
+       the list whenever a window is opened, closed or changes workspace */
+    QHash<BamfWindow*, WindowInfo*> m_windowsByBamfWindow;
+    QHash<unsigned int, WindowInfo*> m_windowsByXid;
+    /* Reverse of the two indexes above, so that removing a window does not
+       need to scan them */
+    QHash<WindowInfo*, BamfWindow*> m_bamfWindows;
+    QHash<WindowInfo*, unsigned int> m_xids;
+    QHash<WindowInfo*, int> m_rows;
+    QMultiHash<QString, WindowInfo*> m_windowsByDesktopFile;
+    QMultiHash<int, WindowInfo*> m_windowsByWorkspace;
+    /* Workspace each window is indexed under in m_windowsByWorkspace */
+    QHash<WindowInfo*, int> m_workspaces;
+    bool m_resident;
+    bool m_loaded;
 };
 
 QML_DECLARE_TYPE(WindowsList)
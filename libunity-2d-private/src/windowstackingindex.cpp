@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libwnck/libwnck.h>
+
+#include "windowstackingindex.h"
+
+WindowStackingIndex::WindowStackingIndex(QObject *parent) :
+    QObject(parent)
+{
+    WnckScreen *screen = wnck_screen_get_default();
+    g_signal_connect(G_OBJECT(screen), "window-stacking-changed",
+                     G_CALLBACK(WindowStackingIndex::onWindowStackingChanged), NULL);
+
+    update(screen);
+}
+
+WindowStackingIndex* WindowStackingIndex::instance()
+{
+    static WindowStackingIndex* singleton = new WindowStackingIndex();
+    return singleton;
+}
+
+unsigned int WindowStackingIndex::z(unsigned int xid) const
+{
+    return m_positions.value(xid, m_positions.count());
+}
+
+void WindowStackingIndex::watch(unsigned int xid, QObject *receiver, const char *member)
+{
+    m_receivers.add(xid, receiver, member);
+}
+
+void WindowStackingIndex::unwatch(unsigned int xid, QObject *receiver)
+{
+    m_receivers.remove(xid, receiver);
+}
+
+void WindowStackingIndex::onWindowStackingChanged(WnckScreen *screen, gpointer user_data)
+{
+    Q_UNUSED(user_data);
+
+    WindowStackingIndex::instance()->update(screen);
+}
+
+void WindowStackingIndex::update(WnckScreen *screen)
+{
+    QHash<unsigned int, unsigned int> previous = m_positions;
+
+    m_positions.clear();
+    unsigned int z = 0;
+    for (GList *cur = wnck_screen_get_windows_stacked(screen); cur != NULL; cur = g_list_next(cur)) {
+        z++;
+        m_positions.insert(wnck_window_get_xid(WNCK_WINDOW(cur->data)), z);
+    }
+
+    QHash<unsigned int, unsigned int>::const_iterator it;
+    for (it = m_positions.constBegin(); it != m_positions.constEnd(); ++it) {
+        if (previous.value(it.key(), 0) != it.value()) {
+            m_receivers.notify(it.key(), Q_ARG(unsigned int, it.key()),
+                               Q_ARG(unsigned int, it.value()));
+            Q_EMIT zChanged(it.key(), it.value());
+        }
+    }
+}
+
+#include "windowstackingindex.moc"
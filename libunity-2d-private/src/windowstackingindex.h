@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWSTACKINGINDEX_H
+#define WINDOWSTACKINGINDEX_H
+
+#include <QObject>
+#include <QHash>
+
+#include "windowreceivers.h"
+
+typedef void* gpointer;
+typedef struct _WnckScreen WnckScreen;
+
+/* Process wide index of the stacking order of the windows, so that the
+   position of a window in the stack can be known without walking the
+   whole stack every time.
+
+   The index is rebuilt when wnck reports that the stacking order changed,
+   and zChanged is only emitted for the windows that actually moved.
+   Receivers interested in a single window should watch() it instead of
+   connecting to zChanged, so that they do not get the moves of all the
+   other windows.
+*/
+class WindowStackingIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    static WindowStackingIndex* instance();
+
+    /* Position of the window in the stack, starting from 1 for the bottom
+       window. Windows that are not in the stack get the position of the
+       topmost window. */
+    unsigned int z(unsigned int xid) const;
+
+    /* Calls member of receiver with the XID and the new position of the
+       window whenever it moves in the stack */
+    void watch(unsigned int xid, QObject *receiver, const char *member);
+    void unwatch(unsigned int xid, QObject *receiver);
+
+Q_SIGNALS:
+    void zChanged(unsigned int xid, unsigned int z);
+
+private:
+    explicit WindowStackingIndex(QObject *parent = 0);
+    void update(WnckScreen *screen);
+
+    static void onWindowStackingChanged(WnckScreen *screen, gpointer user_data);
+
+    QHash<unsigned int, unsigned int> m_positions;
+    WindowReceivers m_receivers;
+};
+
+#endif // WINDOWSTACKINGINDEX_H
@@ -0,0 +1,623 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "windowthumbnailcache.h"
+
+// Local
+#include "windowcapturepipeline.h"
+#include "windowgrabber.h"
+#include "windowreceivers.h"
+#include <debug_p.h>
+
+// Qt
+#include <QX11Info>
+#include <QHash>
+#include <QList>
+#include <QRegion>
+
+// libc
+#include <math.h>
+
+// X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+
+/* Past this number of damaged rectangles it's cheaper to read back their
+   bounding rectangle in one go than doing one request per rectangle */
+static const int MAX_DAMAGED_RECTS = 16;
+
+static const qint64 DEFAULT_MEMORY_BUDGET = 32 * 1024 * 1024;
+
+struct WindowThumbnail
+{
+    WindowThumbnail()
+    : damage(None)
+    , depth(0)
+    , visual(NULL)
+    , sourcePicture(None)
+    , scaledPixmap(None)
+    , scaledPicture(None)
+    , viewable(false)
+    , dirty(true)
+    , capturePending(false)
+    , generation(0)
+    {}
+
+    Damage damage;
+    QImage image;
+    QRegion damagedRegion;
+    QSize size;
+    int depth;
+    Visual* visual;
+    /* Only used when a downscaled image is requested, see renderScaledArea */
+    Picture sourcePicture;
+    Pixmap scaledPixmap;
+    Picture scaledPicture;
+    bool viewable;
+    /* True if the window got damaged since its contents were last read. The
+       generation is only bumped when this goes from false to true so that
+       a window being continuously redrawn does not flood consumers. */
+    bool dirty;
+    /* True while the whole window is being read by the capture pipeline */
+    bool capturePending;
+    unsigned int generation;
+};
+
+struct WindowThumbnailCachePrivate
+{
+    WindowThumbnailCachePrivate()
+    : m_grabber(QX11Info::display())
+    , m_pipeline(NULL)
+    , m_damageEventBase(0)
+    , m_supportsDamage(false)
+    , m_scaleFilter(WindowThumbnailCache::Bilinear)
+    , m_memoryUsage(0)
+    , m_memoryBudget(DEFAULT_MEMORY_BUDGET)
+    , m_evictionCount(0)
+    , m_evictedBytes(0)
+    {}
+
+    WindowThumbnail* thumbnail(Window windowId);
+    void collectDamage(WindowThumbnail* thumbnail);
+    void markDirty(Window windowId, WindowThumbnail* thumbnail);
+    void releaseScaledPixmap(WindowThumbnail* thumbnail);
+    void destroyThumbnail(Window windowId, WindowThumbnail* thumbnail);
+    void setImage(WindowThumbnail* thumbnail, const QImage& image);
+    void touch(Window windowId);
+    void enforceMemoryBudget();
+    bool readArea(Drawable drawable, WindowThumbnail* thumbnail, const QRect& rect);
+    bool renderScaledArea(Window windowId, WindowThumbnail* thumbnail, const QRect& rect);
+
+    WindowThumbnailCache* q;
+    QHash<Window, WindowThumbnail*> m_thumbnails;
+    QHash<Window, int> m_priorities;
+    WindowReceivers m_receivers;
+    WindowGrabber m_grabber;
+    WindowCapturePipeline* m_pipeline;
+    int m_damageEventBase;
+    bool m_supportsDamage;
+    WindowThumbnailCache::ScaleFilter m_scaleFilter;
+
+    /* Least recently used first */
+    QList<Window> m_recentlyUsed;
+    qint64 m_memoryUsage;
+    qint64 m_memoryBudget;
+    int m_evictionCount;
+    qint64 m_evictedBytes;
+};
+
+WindowThumbnail* WindowThumbnailCachePrivate::thumbnail(Window windowId)
+{
+    WindowThumbnail* thumbnail = m_thumbnails.value(windowId);
+    if (thumbnail != NULL && m_supportsDamage) {
+        /* Geometry and map state are kept up to date by x11EventFilter */
+        return thumbnail;
+    }
+
+    Display* display = QX11Info::display();
+    XWindowAttributes attributes;
+    if (XGetWindowAttributes(display, windowId, &attributes) == 0) {
+        if (thumbnail != NULL) {
+            destroyThumbnail(windowId, m_thumbnails.take(windowId));
+        }
+        return NULL;
+    }
+
+    if (thumbnail == NULL) {
+        thumbnail = new WindowThumbnail;
+        if (m_supportsDamage) {
+            /* Keep whatever events we (or Qt, in the case of the root window)
+               already selected on this window */
+            XSelectInput(display, windowId, attributes.your_event_mask | StructureNotifyMask);
+            /* NonEmpty only reports the transition from undamaged to damaged, the
+               actual damaged region is collected when the image is requested */
+            thumbnail->damage = XDamageCreate(display, windowId, XDamageReportNonEmpty);
+        }
+        m_thumbnails.insert(windowId, thumbnail);
+    }
+
+    thumbnail->size = QSize(attributes.width, attributes.height);
+    thumbnail->depth = attributes.depth;
+    thumbnail->visual = attributes.visual;
+    thumbnail->viewable = (attributes.map_state == IsViewable);
+    return thumbnail;
+}
+
+void WindowThumbnailCachePrivate::collectDamage(WindowThumbnail* thumbnail)
+{
+    if (thumbnail->damage == None) {
+        thumbnail->damagedRegion = QRect(QPoint(0, 0), thumbnail->size);
+        return;
+    }
+
+    Display* display = QX11Info::display();
+    XserverRegion parts = XFixesCreateRegion(display, NULL, 0);
+    XDamageSubtract(display, thumbnail->damage, None, parts);
+
+    int count;
+    XRectangle* rectangles = XFixesFetchRegion(display, parts, &count);
+    for (int i = 0; i < count; i++) {
+        XRectangle r = rectangles[i];
+        thumbnail->damagedRegion += QRect(r.x, r.y, r.width, r.height);
+    }
+    if (rectangles != NULL) {
+        XFree(rectangles);
+    }
+    XFixesDestroyRegion(display, parts);
+}
+
+void WindowThumbnailCachePrivate::markDirty(Window windowId, WindowThumbnail* thumbnail)
+{
+    if (thumbnail->dirty) {
+        return;
+    }
+    thumbnail->dirty = true;
+    thumbnail->generation++;
+    unsigned int xid = windowId;
+    m_receivers.notify(xid, Q_ARG(unsigned int, xid),
+                       Q_ARG(unsigned int, thumbnail->generation));
+    Q_EMIT q->generationChanged(windowId, thumbnail->generation);
+}
+
+void WindowThumbnailCachePrivate::releaseScaledPixmap(WindowThumbnail* thumbnail)
+{
+    Display* display = QX11Info::display();
+    if (thumbnail->scaledPicture != None) {
+        XRenderFreePicture(display, thumbnail->scaledPicture);
+        thumbnail->scaledPicture = None;
+    }
+    if (thumbnail->scaledPixmap != None) {
+        XFreePixmap(display, thumbnail->scaledPixmap);
+        thumbnail->scaledPixmap = None;
+    }
+}
+
+void WindowThumbnailCachePrivate::destroyThumbnail(Window windowId, WindowThumbnail* thumbnail)
+{
+    m_recentlyUsed.removeOne(windowId);
+    setImage(thumbnail, QImage());
+    releaseScaledPixmap(thumbnail);
+    if (thumbnail->sourcePicture != None) {
+        XRenderFreePicture(QX11Info::display(), thumbnail->sourcePicture);
+    }
+    delete thumbnail;
+}
+
+void WindowThumbnailCachePrivate::setImage(WindowThumbnail* thumbnail, const QImage& image)
+{
+    m_memoryUsage += image.byteCount() - thumbnail->image.byteCount();
+    thumbnail->image = image;
+}
+
+void WindowThumbnailCachePrivate::touch(Window windowId)
+{
+    m_recentlyUsed.removeOne(windowId);
+    m_recentlyUsed.append(windowId);
+}
+
+/* Drops the images of the least recently used windows until the budget is
+   met. The most recently used image is always kept, whatever its size. */
+void WindowThumbnailCachePrivate::enforceMemoryBudget()
+{
+    while (m_memoryUsage > m_memoryBudget && m_recentlyUsed.count() > 1) {
+        Window windowId = m_recentlyUsed.takeFirst();
+        WindowThumbnail* thumbnail = m_thumbnails.value(windowId);
+        if (thumbnail == NULL || thumbnail->image.isNull()) {
+            continue;
+        }
+        m_evictionCount++;
+        m_evictedBytes += thumbnail->image.byteCount();
+        UQ_DEBUG << "Evicting thumbnail of window" << windowId
+                 << "(" << thumbnail->image.byteCount() << "bytes)";
+        /* The window will be read again entirely next time, see image() */
+        setImage(thumbnail, QImage());
+        releaseScaledPixmap(thumbnail);
+    }
+}
+
+/* Maps a rectangle of the window to the corresponding rectangle of the
+   downscaled image. It is grown by one pixel on each side since bilinear
+   filtering makes every source pixel contribute to its neighbours. */
+static QRect scaleRect(const QRect& rect, const QSize& from, const QSize& to)
+{
+    qreal xScale = qreal(to.width()) / from.width();
+    qreal yScale = qreal(to.height()) / from.height();
+    int left = int(floor(rect.left() * xScale)) - 1;
+    int top = int(floor(rect.top() * yScale)) - 1;
+    int right = int(ceil((rect.right() + 1) * xScale)) + 1;
+    int bottom = int(ceil((rect.bottom() + 1) * yScale)) + 1;
+    return QRect(left, top, right - left, bottom - top) & QRect(QPoint(0, 0), to);
+}
+
+bool WindowThumbnailCachePrivate::readArea(Drawable drawable, WindowThumbnail* thumbnail,
+                                           const QRect& rect)
+{
+    return m_grabber.readArea(drawable, XVisualIDFromVisual(thumbnail->visual),
+                              thumbnail->depth, rect, &thumbnail->image);
+}
+
+/* Renders rect of the downscaled image server side, using an XRender
+   transform on the window contents, then reads it back. This way only the
+   pixels of the thumbnail go to the client, not the ones of the window. */
+bool WindowThumbnailCachePrivate::renderScaledArea(Window windowId, WindowThumbnail* thumbnail,
+                                                   const QRect& rect)
+{
+    Display* display = QX11Info::display();
+    QSize scaledSize = thumbnail->image.size();
+
+    if (thumbnail->sourcePicture == None) {
+        XRenderPictFormat* format = XRenderFindVisualFormat(display, thumbnail->visual);
+        if (format == NULL) {
+            return false;
+        }
+        XRenderPictureAttributes attributes;
+        attributes.subwindow_mode = IncludeInferiors;
+        thumbnail->sourcePicture = XRenderCreatePicture(display, windowId, format,
+                                                        CPSubwindowMode, &attributes);
+    }
+
+    if (thumbnail->scaledPixmap == None) {
+        thumbnail->scaledPixmap = XCreatePixmap(display, windowId, scaledSize.width(),
+                                                scaledSize.height(), thumbnail->depth);
+        XRenderPictFormat* format = XRenderFindVisualFormat(display, thumbnail->visual);
+        thumbnail->scaledPicture = XRenderCreatePicture(display, thumbnail->scaledPixmap,
+                                                        format, 0, NULL);
+    }
+
+    m_grabber.renderScaledArea(thumbnail->sourcePicture, thumbnail->scaledPicture,
+                               thumbnail->size, scaledSize, rect,
+                               m_scaleFilter == WindowThumbnailCache::Bilinear);
+    return readArea(thumbnail->scaledPixmap, thumbnail, rect);
+}
+
+WindowThumbnailCache::WindowThumbnailCache(QObject* parent)
+: QObject(parent)
+, d(new WindowThumbnailCachePrivate)
+{
+    d->q = this;
+
+    int errorBase;
+
+    d->m_supportsDamage = XDamageQueryExtension(QX11Info::display(),
+                                                &d->m_damageEventBase, &errorBase);
+    if (!d->m_supportsDamage) {
+        UQ_WARNING << "Server doesn't support the Damage extension."
+                      "Windows will be entirely captured on every request.";
+        return;
+    }
+
+    Unity2dApplication* application = Unity2dApplication::instance();
+    if (application == NULL) {
+        /* This can happen for example when using qmlviewer to run the spread */
+        UQ_WARNING << "The application is not an Unity2dApplication."
+                      "Windows will be entirely captured on every request.";
+        d->m_supportsDamage = false;
+    } else {
+        application->installX11EventFilter(this);
+    }
+}
+
+WindowThumbnailCache::~WindowThumbnailCache()
+{
+    delete d->m_pipeline;
+    QHash<Window, WindowThumbnail*>::const_iterator it;
+    for (it = d->m_thumbnails.constBegin(); it != d->m_thumbnails.constEnd(); ++it) {
+        d->destroyThumbnail(it.key(), it.value());
+    }
+    delete d;
+}
+
+WindowThumbnailCache* WindowThumbnailCache::instance()
+{
+    static WindowThumbnailCache* cache = new WindowThumbnailCache();
+    return cache;
+}
+
+void WindowThumbnailCache::setScaleFilter(ScaleFilter filter)
+{
+    if (filter == d->m_scaleFilter) {
+        return;
+    }
+    d->m_scaleFilter = filter;
+    /* Make sure the downscaled images are rendered again with the new filter */
+    Q_FOREACH(WindowThumbnail* thumbnail, d->m_thumbnails) {
+        if (thumbnail->scaledPixmap != None) {
+            thumbnail->damagedRegion = QRect(QPoint(0, 0), thumbnail->size);
+        }
+    }
+}
+
+WindowThumbnailCache::ScaleFilter WindowThumbnailCache::scaleFilter() const
+{
+    return d->m_scaleFilter;
+}
+
+QSize WindowThumbnailCache::windowSize(Window windowId) const
+{
+    WindowThumbnail* thumbnail = d->m_thumbnails.value(windowId);
+    return (thumbnail == NULL) ? QSize() : thumbnail->size;
+}
+
+void WindowThumbnailCache::setAsynchronousCaptureEnabled(bool enabled)
+{
+    if (enabled == (d->m_pipeline != NULL)) {
+        return;
+    }
+
+    if (enabled) {
+        d->m_pipeline = new WindowCapturePipeline;
+        if (!d->m_pipeline->isAvailable()) {
+            delete d->m_pipeline;
+            d->m_pipeline = NULL;
+            return;
+        }
+        connect(d->m_pipeline, SIGNAL(captured(unsigned int, const QImage&)),
+                SLOT(storeCapture(unsigned int, const QImage&)));
+    } else {
+        delete d->m_pipeline;
+        d->m_pipeline = NULL;
+        /* Captures that were pending will never be delivered */
+        Q_FOREACH(WindowThumbnail* thumbnail, d->m_thumbnails) {
+            thumbnail->capturePending = false;
+        }
+    }
+}
+
+bool WindowThumbnailCache::isAsynchronousCaptureEnabled() const
+{
+    return d->m_pipeline != NULL;
+}
+
+void WindowThumbnailCache::setPriority(Window windowId, int priority)
+{
+    d->m_priorities.insert(windowId, priority);
+}
+
+void WindowThumbnailCache::storeCapture(unsigned int windowId, const QImage& image)
+{
+    WindowThumbnail* thumbnail = d->m_thumbnails.value(windowId);
+    if (thumbnail == NULL || !thumbnail->capturePending) {
+        /* The window went away, or asynchronous captures were disabled */
+        return;
+    }
+    thumbnail->capturePending = false;
+
+    if (!image.isNull()) {
+        if (image.size() != thumbnail->image.size()) {
+            d->releaseScaledPixmap(thumbnail);
+        }
+        d->setImage(thumbnail, image);
+        d->touch(windowId);
+        d->enforceMemoryBudget();
+    }
+
+    /* Tell consumers to request the image again, even if the window was
+       damaged meanwhile: the damage is collected on the next request */
+    thumbnail->dirty = false;
+    d->markDirty(windowId, thumbnail);
+}
+
+unsigned int WindowThumbnailCache::generation(Window windowId) const
+{
+    WindowThumbnail* thumbnail = d->m_thumbnails.value(windowId);
+    return (thumbnail == NULL) ? 0 : thumbnail->generation;
+}
+
+void WindowThumbnailCache::watch(Window windowId, QObject* receiver, const char* member)
+{
+    d->m_receivers.add(windowId, receiver, member);
+}
+
+void WindowThumbnailCache::unwatch(Window windowId, QObject* receiver)
+{
+    d->m_receivers.remove(windowId, receiver);
+}
+
+void WindowThumbnailCache::setMemoryBudget(qint64 bytes)
+{
+    d->m_memoryBudget = bytes;
+    d->enforceMemoryBudget();
+}
+
+qint64 WindowThumbnailCache::memoryBudget() const
+{
+    return d->m_memoryBudget;
+}
+
+qint64 WindowThumbnailCache::memoryUsage() const
+{
+    return d->m_memoryUsage;
+}
+
+int WindowThumbnailCache::evictionCount() const
+{
+    return d->m_evictionCount;
+}
+
+qint64 WindowThumbnailCache::evictedBytes() const
+{
+    return d->m_evictedBytes;
+}
+
+bool WindowThumbnailCache::isCapturePending(Window windowId) const
+{
+    WindowThumbnail* thumbnail = d->m_thumbnails.value(windowId);
+    return (thumbnail != NULL) && thumbnail->capturePending;
+}
+
+QImage WindowThumbnailCache::image(Window windowId, const QSize& requestedSize,
+                                   CaptureMode mode)
+{
+    WindowThumbnail* thumbnail = d->thumbnail(windowId);
+    if (thumbnail == NULL) {
+        return QImage();
+    }
+    if (!thumbnail->viewable || thumbnail->size.isEmpty()) {
+        /* Nothing to read, but consumers need to be notified again when the
+           window gets mapped. Meanwhile serve the last contents captured
+           while it was viewable, if they were not evicted. */
+        thumbnail->dirty = false;
+        if (!thumbnail->image.isNull()) {
+            d->touch(windowId);
+        }
+        return thumbnail->image;
+    }
+
+    /* Downscale server side when a smaller image is requested */
+    QSize targetSize = d->m_grabber.scaledSize(thumbnail->size, requestedSize);
+    bool scaled = (targetSize != thumbnail->size);
+
+    if (thumbnail->capturePending) {
+        /* Serve what we have until the capture is delivered */
+        thumbnail->dirty = false;
+        return (thumbnail->image.size() == targetSize) ? thumbnail->image : QImage();
+    }
+
+    /* Always collect pending damage, as the DamageNotify event may still be
+       sitting in the queue */
+    d->collectDamage(thumbnail);
+
+    if (thumbnail->image.size() != targetSize) {
+        if (mode == Asynchronous && d->m_pipeline != NULL) {
+            /* The whole window has to be read: do it in the background and
+               notify consumers through generationChanged when done */
+            thumbnail->damagedRegion = QRegion();
+            thumbnail->capturePending = true;
+            thumbnail->dirty = false;
+            d->m_pipeline->capture(windowId, targetSize, d->m_priorities.value(windowId),
+                                   d->m_scaleFilter == Bilinear);
+            return QImage();
+        }
+        d->setImage(thumbnail, WindowGrabber::createImage(targetSize, thumbnail->depth));
+        thumbnail->damagedRegion = QRect(QPoint(0, 0), thumbnail->size);
+        d->releaseScaledPixmap(thumbnail);
+        d->touch(windowId);
+        d->enforceMemoryBudget();
+    }
+
+    thumbnail->damagedRegion &= QRect(QPoint(0, 0), thumbnail->size);
+    if (!thumbnail->damagedRegion.isEmpty()) {
+        QVector<QRect> rects = thumbnail->damagedRegion.rects();
+        if (scaled) {
+            QRegion scaledRegion;
+            Q_FOREACH(const QRect& rect, rects) {
+                scaledRegion += scaleRect(rect, thumbnail->size, targetSize);
+            }
+            rects = scaledRegion.rects();
+        }
+        if (rects.count() > MAX_DAMAGED_RECTS) {
+            QRect boundingRect;
+            Q_FOREACH(const QRect& rect, rects) {
+                boundingRect |= rect;
+            }
+            rects = QVector<QRect>() << boundingRect;
+        }
+        Q_FOREACH(const QRect& rect, rects) {
+            bool read = scaled ? d->renderScaledArea(windowId, thumbnail, rect)
+                               : d->readArea(windowId, thumbnail, rect);
+            if (!read) {
+                /* Keep the region damaged so that it's read again next time */
+                return QImage();
+            }
+        }
+        thumbnail->damagedRegion = QRegion();
+    }
+
+    thumbnail->dirty = false;
+    d->touch(windowId);
+    return thumbnail->image;
+}
+
+bool WindowThumbnailCache::x11EventFilter(XEvent* event)
+{
+    if (event->type == d->m_damageEventBase + XDamageNotify) {
+        XDamageNotifyEvent* damageEvent = reinterpret_cast<XDamageNotifyEvent*>(event);
+        WindowThumbnail* thumbnail = d->m_thumbnails.value(damageEvent->drawable);
+        if (thumbnail != NULL) {
+            d->markDirty(damageEvent->drawable, thumbnail);
+        }
+        return false;
+    }
+
+    switch (event->type) {
+    case ConfigureNotify: {
+        WindowThumbnail* thumbnail = d->m_thumbnails.value(event->xconfigure.window);
+        if (thumbnail != NULL) {
+            QSize size(event->xconfigure.width, event->xconfigure.height);
+            if (size != thumbnail->size) {
+                thumbnail->size = size;
+                thumbnail->damagedRegion = QRect(QPoint(0, 0), size);
+                d->markDirty(event->xconfigure.window, thumbnail);
+            }
+        }
+        break;
+    }
+    case MapNotify:
+    case UnmapNotify: {
+        Window windowId = (event->type == MapNotify) ? event->xmap.window : event->xunmap.window;
+        WindowThumbnail* thumbnail = d->m_thumbnails.value(windowId);
+        if (thumbnail != NULL) {
+            thumbnail->viewable = (event->type == MapNotify);
+            /* The backing pixmap of a redirected window does not survive
+               unmapping, so its contents have to be read again entirely */
+            thumbnail->damagedRegion = QRect(QPoint(0, 0), thumbnail->size);
+            d->markDirty(windowId, thumbnail);
+        }
+        break;
+    }
+    case DestroyNotify: {
+        /* The server already freed the Damage object and the source picture
+           along with the window, freeing the picture again would raise a
+           BadPicture error */
+        d->m_priorities.remove(event->xdestroywindow.window);
+        WindowThumbnail* thumbnail = d->m_thumbnails.take(event->xdestroywindow.window);
+        if (thumbnail != NULL) {
+            thumbnail->sourcePicture = None;
+            d->destroyThumbnail(event->xdestroywindow.window, thumbnail);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return false;
+}
+
+#include "windowthumbnailcache.moc"
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWTHUMBNAILCACHE_H
+#define WINDOWTHUMBNAILCACHE_H
+
+// Local
+#include <unity2dapplication.h>
+
+// Qt
+#include <QObject>
+#include <QImage>
+
+typedef unsigned long Window;
+
+struct WindowThumbnailCachePrivate;
+
+/**
+ * Keeps the last captured contents of every window an image was requested
+ * for, and subscribes to XDamage on each of them so that only the regions
+ * which actually changed are read back from the X server on the next request.
+ *
+ * Every window has a generation counter which is incremented the first time
+ * the window gets damaged after its contents were last read. Consumers (see
+ * WindowInfo::thumbnailGeneration) can use it as part of the image URL so that
+ * QML only re-requests images that changed.
+ *
+ * The last contents of windows are kept after they get unmapped, so that
+ * minimized windows and windows of other workspaces can still be shown.
+ * Images are dropped in least recently used order when their total size
+ * goes over the memory budget.
+ *
+ * You *must* use Unity2dApplication for the damage tracking to work, otherwise
+ * every request re-reads the whole window.
+ */
+class WindowThumbnailCache : public QObject, protected AbstractX11EventFilter
+{
+Q_OBJECT
+public:
+    enum ScaleFilter {
+        Nearest,
+        Bilinear
+    };
+
+    enum CaptureMode {
+        Synchronous,
+        Asynchronous
+    };
+
+    static WindowThumbnailCache* instance();
+
+    /**
+     * Returns the up to date contents of the window. If the window is not
+     * viewable (for example because it's minimized), returns its contents as
+     * of the last time it was, or a null image if they are not known.
+     *
+     * If requestedSize is valid and smaller than the window, the image is
+     * downscaled by the X server (using XRender) before being transferred.
+     *
+     * In Asynchronous mode, if the whole window needs to be read (typically
+     * the first time), it is read in the background and a null image is
+     * returned. generationChanged is emitted when the image is ready.
+     * Reads of damaged areas are always synchronous.
+     */
+    QImage image(Window windowId, const QSize& requestedSize = QSize(),
+                 CaptureMode mode = Synchronous);
+
+    /**
+     * Enables the background capture pipeline used by the Asynchronous mode.
+     * Disabled by default, in which case Asynchronous behaves like Synchronous.
+     */
+    void setAsynchronousCaptureEnabled(bool enabled);
+    bool isAsynchronousCaptureEnabled() const;
+
+    /**
+     * Background captures of windows with a higher priority are done first.
+     * The default priority is 0.
+     */
+    void setPriority(Window windowId, int priority);
+
+    /**
+     * The filter used by the X server when downscaling windows.
+     * Nearest is faster, Bilinear looks better. Defaults to Bilinear.
+     */
+    void setScaleFilter(ScaleFilter filter);
+    ScaleFilter scaleFilter() const;
+
+    /**
+     * The size of the window as of the last request, which is not the
+     * size of the image if it was downscaled.
+     */
+    QSize windowSize(Window windowId) const;
+
+    unsigned int generation(Window windowId) const;
+
+    /**
+     * Calls member of receiver with the window id and its new generation
+     * whenever the generation of the window changes. Unlike a connection to
+     * generationChanged, only the changes of that window are delivered.
+     */
+    void watch(Window windowId, QObject* receiver, const char* member);
+    void unwatch(Window windowId, QObject* receiver);
+
+    /**
+     * Maximum total size of the images kept, in bytes. Defaults to 32 MiB.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+
+    /**
+     * Statistics: total size of the images currently kept, and number and
+     * total size of the images evicted so far to meet the budget.
+     */
+    qint64 memoryUsage() const;
+    int evictionCount() const;
+    qint64 evictedBytes() const;
+
+    /**
+     * Returns true while a background capture of the window is in progress.
+     */
+    bool isCapturePending(Window windowId) const;
+
+Q_SIGNALS:
+    void generationChanged(unsigned int windowId, unsigned int generation);
+
+protected:
+    bool x11EventFilter(XEvent*);
+
+private Q_SLOTS:
+    void storeCapture(unsigned int windowId, const QImage& image);
+
+private:
+    WindowThumbnailCache(QObject* parent = 0);
+    ~WindowThumbnailCache();
+
+    WindowThumbnailCachePrivate* const d;
+};
+
+#endif // WINDOWTHUMBNAILCACHE_H
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "windowthumbnailitem.h"
+#include "windowthumbnailregistry.h"
+
+#include <QPainter>
+
+/* Time the size of the item has to stay the same before the window is
+   captured at that size, in milliseconds */
+static const int GEOMETRY_SETTLE_DELAY = 100;
+
+DeclarativeWindowThumbnail::DeclarativeWindowThumbnail(QDeclarativeItem* parent)
+    : QDeclarativeItem(parent)
+    , m_windowId(0)
+    , m_contentId(0)
+    , m_live(true)
+    , m_dirty(false)
+    , m_refreshScheduled(false)
+{
+    setFlag(QGraphicsItem::ItemHasNoContents, false);
+    m_geometryTimer.setSingleShot(true);
+    m_geometryTimer.setInterval(GEOMETRY_SETTLE_DELAY);
+    connect(&m_geometryTimer, SIGNAL(timeout()), SLOT(onGeometrySettled()));
+}
+
+DeclarativeWindowThumbnail::~DeclarativeWindowThumbnail()
+{
+    if (m_windowId != 0) {
+        WindowThumbnailRegistry::instance()->release(m_windowId, this);
+    }
+}
+
+unsigned int DeclarativeWindowThumbnail::windowId() const
+{
+    return m_windowId;
+}
+
+unsigned int DeclarativeWindowThumbnail::contentId() const
+{
+    return m_contentId;
+}
+
+bool DeclarativeWindowThumbnail::live() const
+{
+    return m_live;
+}
+
+bool DeclarativeWindowThumbnail::valid() const
+{
+    return !m_image.isNull();
+}
+
+void DeclarativeWindowThumbnail::setWindowId(unsigned int windowId)
+{
+    if (windowId == m_windowId) {
+        return;
+    }
+
+    WindowThumbnailRegistry* registry = WindowThumbnailRegistry::instance();
+    if (m_windowId != 0) {
+        registry->release(m_windowId, this);
+    }
+    m_windowId = windowId;
+    if (m_windowId != 0) {
+        registry->acquire(m_windowId, this, "onThumbnailChanged");
+    }
+    Q_EMIT windowIdChanged(windowId);
+
+    bool wasValid = valid();
+    m_image = QImage();
+    if (wasValid) {
+        Q_EMIT validChanged(false);
+    }
+    update();
+    scheduleRefresh();
+}
+
+void DeclarativeWindowThumbnail::setContentId(unsigned int contentId)
+{
+    if (contentId != m_contentId) {
+        m_contentId = contentId;
+        Q_EMIT contentIdChanged(contentId);
+        scheduleRefresh();
+    }
+}
+
+void DeclarativeWindowThumbnail::setLive(bool live)
+{
+    if (live != m_live) {
+        m_live = live;
+        Q_EMIT liveChanged(live);
+        if (m_live && m_dirty) {
+            scheduleRefresh();
+        }
+    }
+}
+
+void DeclarativeWindowThumbnail::onThumbnailChanged(unsigned int windowId)
+{
+    Q_UNUSED(windowId)
+
+    scheduleRefresh();
+}
+
+void DeclarativeWindowThumbnail::geometryChanged(const QRectF& newGeometry,
+                                                 const QRectF& oldGeometry)
+{
+    QDeclarativeItem::geometryChanged(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        m_geometryTimer.start();
+    }
+}
+
+void DeclarativeWindowThumbnail::onGeometrySettled()
+{
+    /* The registry only captures the window again if it's now shown bigger
+       than it was captured */
+    if (m_dirty || width() > m_image.width() || height() > m_image.height()) {
+        scheduleRefresh();
+    }
+}
+
+/* Refreshes are done once control gets back to the event loop, so that all
+   the items showing a window that changed get the same new image and
+   property changes done in a row trigger only one refresh */
+void DeclarativeWindowThumbnail::scheduleRefresh()
+{
+    m_dirty = true;
+    if (m_live && !m_refreshScheduled && m_windowId != 0 && !m_geometryTimer.isActive()) {
+        m_refreshScheduled = true;
+        QMetaObject::invokeMethod(this, "refresh", Qt::QueuedConnection);
+    }
+}
+
+void DeclarativeWindowThumbnail::refresh()
+{
+    m_refreshScheduled = false;
+    if (!m_live || !m_dirty || m_windowId == 0) {
+        return;
+    }
+    if (m_geometryTimer.isActive()) {
+        /* Done by onGeometrySettled */
+        return;
+    }
+    m_dirty = false;
+
+    bool wasValid = valid();
+    m_image = WindowThumbnailRegistry::instance()->image(m_windowId, m_contentId,
+                                                         QSize(qRound(width()), qRound(height())));
+    if (valid() != wasValid) {
+        Q_EMIT validChanged(valid());
+    }
+    update();
+}
+
+void DeclarativeWindowThumbnail::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+                                       QWidget* widget)
+{
+    Q_UNUSED(option)
+    Q_UNUSED(widget)
+
+    if (m_image.isNull()) {
+        return;
+    }
+    bool oldSmooth = painter->testRenderHint(QPainter::SmoothPixmapTransform);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, smooth());
+    painter->drawImage(QRectF(0, 0, width(), height()), m_image, m_image.rect());
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, oldSmooth);
+}
+
+#include "windowthumbnailitem.moc"
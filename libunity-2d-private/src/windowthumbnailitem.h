@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWTHUMBNAILITEM_H
+#define WINDOWTHUMBNAILITEM_H
+
+#include <QDeclarativeItem>
+#include <QImage>
+#include <QTimer>
+
+/* Draws the contents of a window, stretched to the size of the item.
+   The image comes from WindowThumbnailRegistry and is shared with the
+   other items showing the same window.
+   The image is only requested once the size of the item stopped changing,
+   so that the window is not captured at every intermediate size of an
+   animation, typically at its full size at the start of the spread. */
+class DeclarativeWindowThumbnail : public QDeclarativeItem
+{
+    Q_OBJECT
+
+    /* XID of the window including its decorations, and of its contents */
+    Q_PROPERTY(unsigned int windowId READ windowId WRITE setWindowId NOTIFY windowIdChanged)
+    Q_PROPERTY(unsigned int contentId READ contentId WRITE setContentId NOTIFY contentIdChanged)
+    /* While false, the image shown is not updated when the window changes */
+    Q_PROPERTY(bool live READ live WRITE setLive NOTIFY liveChanged)
+    /* False if there's nothing to show, for example before the window is
+       first captured */
+    Q_PROPERTY(bool valid READ valid NOTIFY validChanged)
+
+public:
+    DeclarativeWindowThumbnail(QDeclarativeItem* parent = 0);
+    ~DeclarativeWindowThumbnail();
+
+    /* getters */
+    unsigned int windowId() const;
+    unsigned int contentId() const;
+    bool live() const;
+    bool valid() const;
+
+    /* setters */
+    void setWindowId(unsigned int windowId);
+    void setContentId(unsigned int contentId);
+    void setLive(bool live);
+
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
+Q_SIGNALS:
+    void windowIdChanged(unsigned int windowId);
+    void contentIdChanged(unsigned int contentId);
+    void liveChanged(bool live);
+    void validChanged(bool valid);
+
+protected:
+    void geometryChanged(const QRectF& newGeometry, const QRectF& oldGeometry);
+
+private Q_SLOTS:
+    void onThumbnailChanged(unsigned int windowId);
+    void onGeometrySettled();
+    void refresh();
+
+private:
+    void scheduleRefresh();
+
+    unsigned int m_windowId;
+    unsigned int m_contentId;
+    bool m_live;
+    bool m_dirty;
+    bool m_refreshScheduled;
+    QImage m_image;
+    /* Running while the size of the item keeps changing */
+    QTimer m_geometryTimer;
+};
+
+#endif // WINDOWTHUMBNAILITEM_H
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "windowthumbnailregistry.h"
+
+// Local
+#include "windowimageprovider.h"
+#include "windowreceivers.h"
+#include "windowthumbnailcache.h"
+#include <debug_p.h>
+
+// Qt
+#include <QHash>
+
+struct SharedThumbnail
+{
+    SharedThumbnail()
+    : references(0)
+    , stale(true)
+    {}
+
+    int references;
+    QImage image;
+    /* Size requested for the last capture */
+    QSize capturedSize;
+    /* True if the window changed since the image was captured */
+    bool stale;
+};
+
+struct WindowThumbnailRegistryPrivate
+{
+    WindowThumbnailRegistryPrivate()
+    : m_provider(NULL)
+    , m_captureCount(0)
+    {}
+
+    QHash<Window, SharedThumbnail*> m_thumbnails;
+    /* Views to notify when their window changed */
+    WindowReceivers m_receivers;
+    /* Created on the first capture. The setup of the X server and of the
+       thumbnail cache is shared with the providers of the declarative
+       engines, so this one only costs its own allocation. */
+    WindowImageProvider* m_provider;
+    int m_captureCount;
+};
+
+WindowThumbnailRegistry::WindowThumbnailRegistry(QObject* parent)
+: QObject(parent)
+, d(new WindowThumbnailRegistryPrivate)
+{
+}
+
+WindowThumbnailRegistry::~WindowThumbnailRegistry()
+{
+    qDeleteAll(d->m_thumbnails);
+    delete d->m_provider;
+    delete d;
+}
+
+WindowThumbnailRegistry* WindowThumbnailRegistry::instance()
+{
+    static WindowThumbnailRegistry* registry = new WindowThumbnailRegistry();
+    return registry;
+}
+
+void WindowThumbnailRegistry::acquire(Window frameId, QObject* receiver, const char* member)
+{
+    SharedThumbnail* thumbnail = d->m_thumbnails.value(frameId);
+    if (thumbnail == NULL) {
+        thumbnail = new SharedThumbnail;
+        d->m_thumbnails.insert(frameId, thumbnail);
+        WindowThumbnailCache::instance()->watch(frameId, this, "onGenerationChanged");
+    }
+    thumbnail->references++;
+    d->m_receivers.add(frameId, receiver, member);
+    Q_EMIT statisticsChanged();
+}
+
+void WindowThumbnailRegistry::release(Window frameId, QObject* receiver)
+{
+    SharedThumbnail* thumbnail = d->m_thumbnails.value(frameId);
+    if (thumbnail == NULL) {
+        UQ_WARNING << "Releasing window" << frameId << "which was not acquired";
+        return;
+    }
+    d->m_receivers.remove(frameId, receiver);
+    thumbnail->references--;
+    if (thumbnail->references == 0) {
+        WindowThumbnailCache::instance()->unwatch(frameId, this);
+        delete d->m_thumbnails.take(frameId);
+    }
+    Q_EMIT statisticsChanged();
+}
+
+QImage WindowThumbnailRegistry::image(Window frameId, Window contentId, const QSize& size)
+{
+    SharedThumbnail* thumbnail = d->m_thumbnails.value(frameId);
+    if (thumbnail == NULL) {
+        UQ_WARNING << "Requesting window" << frameId << "which was not acquired";
+        return QImage();
+    }
+
+    /* Views showing the window smaller than it was captured draw the image
+       scaled down, without a new capture. Once the window changed, the image
+       is captured again at the size of the first view that asks for it,
+       and views asking for a bigger size later in the same generation get
+       it captured at that bigger size.
+       Views only ask once their geometry is settled (see
+       DeclarativeWindowThumbnail), so the sizes they pass through during
+       animations are never captured. */
+    bool covered = thumbnail->capturedSize.isValid()
+                   && size.width() <= thumbnail->capturedSize.width()
+                   && size.height() <= thumbnail->capturedSize.height();
+    if (!thumbnail->stale && covered) {
+        return thumbnail->image;
+    }
+    QSize requestedSize = thumbnail->stale ? size : size.expandedTo(thumbnail->capturedSize);
+
+    if (d->m_provider == NULL) {
+        d->m_provider = new WindowImageProvider;
+    }
+    QString id = QString("%1|%2").arg(frameId).arg(contentId);
+    QSize imageSize;
+    QImage image = d->m_provider->requestImage(id, &imageSize, requestedSize);
+    thumbnail->stale = false;
+    if (image.isNull() && WindowThumbnailCache::instance()->isCapturePending(frameId)) {
+        /* Keep showing the previous contents until the background capture
+           is done, the receivers will be notified then */
+        return thumbnail->image;
+    }
+
+    thumbnail->capturedSize = requestedSize;
+    thumbnail->image = image;
+    d->m_captureCount++;
+    Q_EMIT statisticsChanged();
+    return thumbnail->image;
+}
+
+void WindowThumbnailRegistry::onGenerationChanged(unsigned int windowId, unsigned int generation)
+{
+    Q_UNUSED(generation)
+
+    SharedThumbnail* thumbnail = d->m_thumbnails.value(windowId);
+    if (thumbnail != NULL && !thumbnail->stale) {
+        thumbnail->stale = true;
+        /* Start over from the size views will request next */
+        thumbnail->capturedSize = QSize();
+        d->m_receivers.notify(windowId, Q_ARG(unsigned int, windowId));
+    }
+}
+
+int WindowThumbnailRegistry::thumbnailCount() const
+{
+    int count = 0;
+    Q_FOREACH(SharedThumbnail* thumbnail, d->m_thumbnails) {
+        if (!thumbnail->image.isNull()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int WindowThumbnailRegistry::referenceCount() const
+{
+    int count = 0;
+    Q_FOREACH(SharedThumbnail* thumbnail, d->m_thumbnails) {
+        count += thumbnail->references;
+    }
+    return count;
+}
+
+int WindowThumbnailRegistry::captureCount() const
+{
+    return d->m_captureCount;
+}
+
+qint64 WindowThumbnailRegistry::memoryUsage() const
+{
+    qint64 usage = 0;
+    Q_FOREACH(SharedThumbnail* thumbnail, d->m_thumbnails) {
+        usage += thumbnail->image.byteCount();
+    }
+    return usage;
+}
+
+qint64 WindowThumbnailRegistry::savedBytes() const
+{
+    qint64 saved = 0;
+    Q_FOREACH(SharedThumbnail* thumbnail, d->m_thumbnails) {
+        saved += qint64(thumbnail->references - 1) * thumbnail->image.byteCount();
+    }
+    return saved;
+}
+
+#include "windowthumbnailregistry.moc"
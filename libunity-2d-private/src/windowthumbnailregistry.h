@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWTHUMBNAILREGISTRY_H
+#define WINDOWTHUMBNAILREGISTRY_H
+
+// Qt
+#include <QImage>
+#include <QObject>
+#include <QSize>
+
+typedef unsigned long Window;
+
+struct WindowThumbnailRegistryPrivate;
+
+/**
+ * Hands out one image per window, shared by all the views showing it.
+ *
+ * When the image provider is used directly every Image element gets its own
+ * copy of the window contents, and the same window shown in several
+ * workspaces of the overview (typically a window pinned to all workspaces)
+ * is captured and stored once per workspace. Instead, views acquire a
+ * reference on the window for as long as they show it, and get from here an
+ * image that is only captured again once the window contents changed (see
+ * WindowThumbnailCache::generation). Views draw it scaled to their size.
+ * The image is the one held by WindowThumbnailCache whenever the window
+ * does not need to be shaped or rescaled, so it is not stored twice.
+ *
+ * The image of a window is dropped when its last reference is released.
+ * Nothing is set up before the first window is acquired, so processes that
+ * never show a thumbnail do not pay for the registry.
+ */
+class WindowThumbnailRegistry : public QObject
+{
+    Q_OBJECT
+
+    /* Statistics */
+    Q_PROPERTY(int thumbnailCount READ thumbnailCount NOTIFY statisticsChanged)
+    Q_PROPERTY(int referenceCount READ referenceCount NOTIFY statisticsChanged)
+    Q_PROPERTY(int captureCount READ captureCount NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 memoryUsage READ memoryUsage NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 savedBytes READ savedBytes NOTIFY statisticsChanged)
+
+public:
+    static WindowThumbnailRegistry* instance();
+
+    /**
+     * Takes a reference on the window for receiver. Until it is released,
+     * member of receiver is called with the frame id whenever the window
+     * changed since its image was captured. Only the receivers of the window
+     * that changed are called.
+     */
+    void acquire(Window frameId, QObject* receiver, const char* member);
+    void release(Window frameId, QObject* receiver);
+
+    /**
+     * Returns the contents of the window, of the biggest size requested
+     * since the window last changed. The image is shared with all the other
+     * views of the window; it is captured again only if the window changed
+     * since the last time, or if a bigger one is requested.
+     * The window must have been acquired.
+     */
+    QImage image(Window frameId, Window contentId, const QSize& size);
+
+    /* Number of windows that have an image */
+    int thumbnailCount() const;
+    /* Number of references held on all windows */
+    int referenceCount() const;
+    /* Number of images captured so far */
+    int captureCount() const;
+    /* Total size of the images, in bytes */
+    qint64 memoryUsage() const;
+    /* Size of the copies that would be kept if views did not share images */
+    qint64 savedBytes() const;
+
+Q_SIGNALS:
+    void statisticsChanged();
+
+private Q_SLOTS:
+    void onGenerationChanged(unsigned int windowId, unsigned int generation);
+
+private:
+    WindowThumbnailRegistry(QObject* parent = 0);
+    ~WindowThumbnailRegistry();
+
+    WindowThumbnailRegistryPrivate* const d;
+};
+
+#endif // WINDOWTHUMBNAILREGISTRY_H
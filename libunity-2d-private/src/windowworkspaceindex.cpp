@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libwnck/libwnck.h>
+
+#include "windowworkspaceindex.h"
+
+const int WindowWorkspaceIndex::NO_WORKSPACE;
+
+static int workspaceNumber(WnckWorkspace *workspace)
+{
+    return (workspace != NULL) ? wnck_workspace_get_number(workspace)
+                               : WindowWorkspaceIndex::NO_WORKSPACE;
+}
+
+WindowWorkspaceIndex::WindowWorkspaceIndex(QObject *parent) :
+    QObject(parent)
+{
+    WnckScreen *screen = wnck_screen_get_default();
+    g_signal_connect(G_OBJECT(screen), "window-opened",
+                     G_CALLBACK(WindowWorkspaceIndex::onWindowOpened), NULL);
+    g_signal_connect(G_OBJECT(screen), "window-closed",
+                     G_CALLBACK(WindowWorkspaceIndex::onWindowClosed), NULL);
+    g_signal_connect(G_OBJECT(screen), "active-workspace-changed",
+                     G_CALLBACK(WindowWorkspaceIndex::onActiveWorkspaceChanged), NULL);
+
+    /* Only the windows wnck already knows about, the others are added when
+       wnck reports them as opened */
+    m_activeWorkspace = workspaceNumber(wnck_screen_get_active_workspace(screen));
+    for (GList *cur = wnck_screen_get_windows(screen); cur != NULL; cur = g_list_next(cur)) {
+        addWindow(WNCK_WINDOW(cur->data));
+    }
+}
+
+WindowWorkspaceIndex* WindowWorkspaceIndex::instance()
+{
+    static WindowWorkspaceIndex* singleton = new WindowWorkspaceIndex();
+    return singleton;
+}
+
+int WindowWorkspaceIndex::workspace(unsigned int xid) const
+{
+    return m_workspaces.value(xid, NO_WORKSPACE);
+}
+
+int WindowWorkspaceIndex::activeWorkspace() const
+{
+    return m_activeWorkspace;
+}
+
+void WindowWorkspaceIndex::watch(unsigned int xid, QObject *receiver, const char *member)
+{
+    m_receivers.add(xid, receiver, member);
+}
+
+void WindowWorkspaceIndex::unwatch(unsigned int xid, QObject *receiver)
+{
+    m_receivers.remove(xid, receiver);
+}
+
+void WindowWorkspaceIndex::addWindow(WnckWindow *window)
+{
+    g_signal_connect(G_OBJECT(window), "workspace-changed",
+                     G_CALLBACK(WindowWorkspaceIndex::onWindowWorkspaceChanged), NULL);
+    updateWindow(window);
+}
+
+void WindowWorkspaceIndex::updateWindow(WnckWindow *window)
+{
+    setWorkspace(wnck_window_get_xid(window), workspaceNumber(wnck_window_get_workspace(window)));
+}
+
+void WindowWorkspaceIndex::setWorkspace(unsigned int xid, int workspace)
+{
+    int previous = m_workspaces.value(xid, NO_WORKSPACE);
+    if (workspace == NO_WORKSPACE) {
+        m_workspaces.remove(xid);
+    } else {
+        m_workspaces.insert(xid, workspace);
+    }
+    if (workspace != previous) {
+        m_receivers.notify(xid, Q_ARG(unsigned int, xid), Q_ARG(int, previous),
+                           Q_ARG(int, workspace));
+        Q_EMIT workspaceChanged(xid, previous, workspace);
+    }
+}
+
+void WindowWorkspaceIndex::onWindowOpened(WnckScreen *screen, WnckWindow *window, gpointer user_data)
+{
+    Q_UNUSED(screen);
+    Q_UNUSED(user_data);
+
+    WindowWorkspaceIndex::instance()->addWindow(window);
+}
+
+void WindowWorkspaceIndex::onWindowClosed(WnckScreen *screen, WnckWindow *window, gpointer user_data)
+{
+    Q_UNUSED(screen);
+    Q_UNUSED(user_data);
+
+    WindowWorkspaceIndex::instance()->setWorkspace(wnck_window_get_xid(window), NO_WORKSPACE);
+}
+
+void WindowWorkspaceIndex::onWindowWorkspaceChanged(WnckWindow *window, gpointer user_data)
+{
+    Q_UNUSED(user_data);
+
+    WindowWorkspaceIndex::instance()->updateWindow(window);
+}
+
+void WindowWorkspaceIndex::onActiveWorkspaceChanged(WnckScreen *screen, WnckWorkspace *previous,
+                                                    gpointer user_data)
+{
+    Q_UNUSED(previous);
+    Q_UNUSED(user_data);
+
+    WindowWorkspaceIndex *index = WindowWorkspaceIndex::instance();
+    int workspace = workspaceNumber(wnck_screen_get_active_workspace(screen));
+    if (workspace != index->m_activeWorkspace) {
+        index->m_activeWorkspace = workspace;
+        Q_EMIT index->activeWorkspaceChanged(workspace);
+    }
+}
+
+#include "windowworkspaceindex.moc"
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWWORKSPACEINDEX_H
+#define WINDOWWORKSPACEINDEX_H
+
+#include <QObject>
+#include <QHash>
+
+#include "windowreceivers.h"
+
+typedef void* gpointer;
+typedef struct _WnckScreen WnckScreen;
+typedef struct _WnckWindow WnckWindow;
+typedef struct _WnckWorkspace WnckWorkspace;
+
+/* Process wide index of the workspace each window is on, kept up to date
+   from the signals of wnck, so that it can be queried without asking wnck
+   about every window and without forcing it to resynchronise with the X
+   server when it does not know a window yet.
+
+   Windows on all workspaces or not on any workspace, as well as windows
+   wnck does not know yet, are on workspace NO_WORKSPACE. */
+class WindowWorkspaceIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int NO_WORKSPACE = -1;
+
+    static WindowWorkspaceIndex* instance();
+
+    int workspace(unsigned int xid) const;
+    int activeWorkspace() const;
+
+    /* Calls member of receiver with the same arguments as workspaceChanged,
+       only when the given window changes workspace. Receivers interested
+       in a few windows should use this rather than connect to
+       workspaceChanged and get the changes of all the windows. */
+    void watch(unsigned int xid, QObject *receiver, const char *member);
+    void unwatch(unsigned int xid, QObject *receiver);
+
+Q_SIGNALS:
+    /* Also emitted when a window is opened or closed, in which case the
+       previous or new workspace is NO_WORKSPACE */
+    void workspaceChanged(unsigned int xid, int previousWorkspace, int workspace);
+    void activeWorkspaceChanged(int workspace);
+
+private:
+    explicit WindowWorkspaceIndex(QObject *parent = 0);
+    void addWindow(WnckWindow *window);
+    void updateWindow(WnckWindow *window);
+    void setWorkspace(unsigned int xid, int workspace);
+
+    static void onWindowOpened(WnckScreen *screen, WnckWindow *window, gpointer user_data);
+    static void onWindowClosed(WnckScreen *screen, WnckWindow *window, gpointer user_data);
+    static void onWindowWorkspaceChanged(WnckWindow *window, gpointer user_data);
+    static void onActiveWorkspaceChanged(WnckScreen *screen, WnckWorkspace *previous,
+                                         gpointer user_data);
+
+    QHash<unsigned int, int> m_workspaces;
+    WindowReceivers m_receivers;
+    int m_activeWorkspace;
+};
+
+#endif // WINDOWWORKSPACEINDEX_H
@@ -0,0 +1,100 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <blendedimageprovider.h>
+
+// Qt
+#include <QDir>
+#include <QImage>
+#include <QtTestGui>
+
+class BlendedImageProviderTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testParseId_data()
+    {
+        QTest::addColumn<QString>("id");
+        QTest::addColumn<bool>("valid");
+        QTest::addColumn<QString>("fileName");
+        QTest::addColumn<QColor>("color");
+
+        QColor halfRed(Qt::red);
+        halfRed.setAlphaF(0.5);
+        QTest::newRow("named color") << "tile.pngcolor=redalpha=0.5" << true
+                                     << "tile.png" << halfRed;
+        QTest::newRow("rgb color") << "/a/tile.pngcolor=ff0000alpha=1" << true
+                                   << "/a/tile.png" << QColor(Qt::red);
+        QTest::newRow("tags in file name") << "color=alpha=color=redalpha=1" << true
+                                           << "color=alpha=" << QColor(Qt::red);
+        QTest::newRow("no file name") << "color=redalpha=1" << false << "" << QColor();
+        QTest::newRow("no color") << "tile.pngcolor=alpha=1" << false << "" << QColor();
+        QTest::newRow("invalid color") << "tile.pngcolor=nothingalpha=1" << false << "" << QColor();
+        QTest::newRow("no alpha") << "tile.pngcolor=redalpha=" << false << "" << QColor();
+        QTest::newRow("invalid alpha") << "tile.pngcolor=redalpha=.5" << false << "" << QColor();
+        QTest::newRow("trailing dot") << "tile.pngcolor=redalpha=1." << false << "" << QColor();
+    }
+
+    void testParseId()
+    {
+        QFETCH(QString, id);
+        QFETCH(bool, valid);
+        QFETCH(QString, fileName);
+        QFETCH(QColor, color);
+
+        QString parsedFileName;
+        QColor parsedColor;
+        QCOMPARE(BlendedImageProvider::parseId(id, &parsedFileName, &parsedColor), valid);
+        if (valid) {
+            QCOMPARE(parsedFileName, fileName);
+            QCOMPARE(parsedColor, color);
+        }
+    }
+
+    void testCache()
+    {
+        QString fileName = QDir::temp().filePath("blendedimageprovidertest.png");
+        QImage source(10, 10, QImage::Format_ARGB32);
+        source.fill(qRgba(255, 255, 255, 255));
+        source.setPixel(0, 0, 0);
+        QVERIFY(source.save(fileName));
+
+        BlendedImageProvider provider(QUrl::fromLocalFile(QDir::tempPath() + "/"));
+        QSize size;
+        QImage image = provider.requestImage(fileName + "color=0000ffalpha=1.0", &size, QSize(20, 20));
+        QCOMPARE(size, QSize(20, 20));
+        QCOMPARE(image.pixel(10, 10), qRgb(0, 0, 255));
+        QCOMPARE(qAlpha(image.pixel(0, 0)), 0);
+        QCOMPARE(provider.missCount(), 1);
+
+        /* Served from memory even though the file is gone */
+        QFile::remove(fileName);
+        QImage cached = provider.requestImage(fileName + "color=bluealpha=1", &size, QSize(20, 20));
+        QCOMPARE(cached, image);
+        QCOMPARE(provider.hitCount(), 1);
+
+        provider.requestImage("blendedimageprovidertest.pngcolor=redalpha=1", &size, QSize(20, 20));
+        QCOMPARE(provider.missCount(), 2);
+        QCOMPARE(size, QSize(20, 20));
+    }
+};
+
+QTEST_MAIN(BlendedImageProviderTest)
+
+#include "blendedimageprovidertest.moc"
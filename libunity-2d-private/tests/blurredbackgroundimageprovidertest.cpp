@@ -0,0 +1,72 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <blurredbackgroundimageprovider.h>
+
+// Qt
+#include <QImage>
+#include <QtTestGui>
+
+class BlurredBackgroundImageProviderTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testUniformImageIsUnchanged()
+    {
+        QImage image(64, 48, QImage::Format_RGB32);
+        image.fill(qRgb(12, 34, 56));
+        QImage blurred = image;
+        BlurredBackgroundImageProvider::blur(&blurred, 3);
+        QCOMPARE(blurred, image);
+    }
+
+    void testDotIsSpread()
+    {
+        QImage image(21, 21, QImage::Format_RGB32);
+        image.fill(qRgb(0, 0, 0));
+        image.setPixel(10, 10, qRgb(255, 255, 255));
+        BlurredBackgroundImageProvider::blur(&image, 1);
+
+        /* The dot got dimmer, its neighbours lighter, far pixels untouched */
+        QVERIFY(qRed(image.pixel(10, 10)) < 255);
+        QVERIFY(qRed(image.pixel(11, 10)) > 0);
+        QCOMPARE(qRed(image.pixel(11, 10)), qRed(image.pixel(9, 10)));
+        QCOMPARE(qRed(image.pixel(10, 11)), qRed(image.pixel(10, 9)));
+        QCOMPARE(image.pixel(0, 0), qRgb(0, 0, 0));
+        QCOMPARE(qAlpha(image.pixel(10, 10)), 255);
+    }
+
+    /* The size of a 1920x1080 screen downscaled 4 times */
+    void benchmarkBlur()
+    {
+        QImage image(480, 270, QImage::Format_RGB32);
+        for (int y = 0; y < image.height(); y++) {
+            for (int x = 0; x < image.width(); x++) {
+                image.setPixel(x, y, qRgb(x % 256, y % 256, (x * y) % 256));
+            }
+        }
+        QBENCHMARK {
+            BlurredBackgroundImageProvider::blur(&image, 3);
+        }
+    }
+};
+
+QTEST_MAIN(BlurredBackgroundImageProviderTest)
+
+#include "blurredbackgroundimageprovidertest.moc"
@@ -0,0 +1,213 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <desktopentryindex.h>
+#include <gscopedpointer.h>
+
+// Qt
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTest>
+
+// GIO
+#include <gio/gdesktopappinfo.h>
+
+static const int APPLICATION_COUNT = 300;
+static const int FAVORITE_COUNT = 30;
+
+static void writeDesktopFile(const QString& path, const QString& exec,
+                             const QString& extra = QString())
+{
+    QDir().mkpath(QFileInfo(path).path());
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+    file.write(QString("[Desktop Entry]\nType=Application\nName=%1\nExec=%2 %U\n%3\n"
+                       "[Desktop Action New]\nExec=other\n")
+               .arg(QFileInfo(path).baseName()).arg(exec).arg(extra).toUtf8());
+}
+
+/* Ids of favorites, half of them nested as wine applications are */
+static QStringList favoriteIds()
+{
+    QStringList ids;
+    for (int i = 0; i < FAVORITE_COUNT; i++) {
+        if (i % 2 == 0) {
+            ids.append(QString("application%1.desktop").arg(i));
+        } else {
+            ids.append(QString("wine-Programs-Application%1-Application%1.desktop").arg(i));
+        }
+    }
+    return ids;
+}
+
+/* What LauncherApplication::setDesktopFile used to do for each id */
+static GDesktopAppInfo* resolveWithGio(const QString& id)
+{
+    QByteArray byte_array = id.toUtf8();
+    GDesktopAppInfo* appInfo = NULL;
+    int slash_index;
+    do {
+        appInfo = g_desktop_app_info_new(byte_array.constData());
+        slash_index = byte_array.indexOf("-");
+        if (slash_index == -1) {
+            break;
+        }
+        byte_array.replace(slash_index, 1, "/");
+    } while (appInfo == NULL);
+    return appInfo;
+}
+
+static void removeRecursively(const QString& path)
+{
+    QDir dir(path);
+    Q_FOREACH(const QFileInfo& info, dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden)) {
+        if (info.isDir()) {
+            removeRecursively(info.filePath());
+        } else {
+            QFile::remove(info.filePath());
+        }
+    }
+    dir.rmdir(path);
+}
+
+class DesktopEntryIndexTest : public QObject
+{
+    Q_OBJECT
+
+    QString m_root;
+    QStringList m_dataDirectories;
+    QString m_cacheFile;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        m_root = QDir::temp().filePath(QString("desktopentryindextest-%1")
+                                       .arg(QCoreApplication::applicationPid()));
+        m_dataDirectories << m_root + "/home" << m_root + "/system";
+        m_cacheFile = m_root + "/cache/desktop-entries";
+
+        QString system = m_dataDirectories.at(1) + "/applications/";
+        for (int i = 0; i < APPLICATION_COUNT; i++) {
+            if (i % 2 == 0) {
+                writeDesktopFile(system + QString("application%1.desktop").arg(i),
+                                 QString("/usr/bin/application%1").arg(i),
+                                 QString("StartupWMClass=Application%1").arg(i));
+            } else {
+                writeDesktopFile(system + QString("wine/Programs/Application%1/Application%1.desktop").arg(i),
+                                 QString("env WINEPREFIX=\"/home/user/.wine\" wine%1").arg(i));
+            }
+        }
+
+        /* Files of the user take precedence */
+        QString home = m_dataDirectories.at(0) + "/applications/";
+        writeDesktopFile(home + "application0.desktop", "custom");
+        writeDesktopFile(home + "application200.desktop", "application200", "Hidden=true");
+
+        /* So that GIO looks at the same files */
+        qputenv("XDG_DATA_HOME", QFile::encodeName(m_dataDirectories.at(0)));
+        qputenv("XDG_DATA_DIRS", QFile::encodeName(m_dataDirectories.at(1)));
+    }
+
+    void cleanupTestCase()
+    {
+        removeRecursively(m_root);
+    }
+
+    void testLookups()
+    {
+        DesktopEntryIndex index(m_dataDirectories, QString());
+        QString system = m_dataDirectories.at(1) + "/applications/";
+        QString home = m_dataDirectories.at(0) + "/applications/";
+
+        QCOMPARE(index.count(), APPLICATION_COUNT - 1);
+        QCOMPARE(index.fileForId("application4.desktop"), system + "application4.desktop");
+        QCOMPARE(index.fileForId("wine-Programs-Application5-Application5.desktop"),
+                 system + "wine/Programs/Application5/Application5.desktop");
+        QCOMPARE(index.fileForId("application0.desktop"), home + "application0.desktop");
+        QCOMPARE(index.fileForId("application200.desktop"), QString());
+        QCOMPARE(index.fileForId("missing.desktop"), QString());
+
+        QCOMPARE(index.fileForExecutable("application4"), system + "application4.desktop");
+        QCOMPARE(index.fileForExecutable("/usr/bin/application4"), system + "application4.desktop");
+        QCOMPARE(index.fileForExecutable("wine5"),
+                 system + "wine/Programs/Application5/Application5.desktop");
+        QCOMPARE(index.fileForWMClass("Application4"), system + "application4.desktop");
+    }
+
+    void testCache()
+    {
+        QFile::remove(m_cacheFile);
+        DesktopEntryIndex built(m_dataDirectories, m_cacheFile);
+        QVERIFY(!built.loadedFromCache());
+
+        DesktopEntryIndex cached(m_dataDirectories, m_cacheFile);
+        QVERIFY(cached.loadedFromCache());
+        QCOMPARE(cached.count(), built.count());
+        QCOMPARE(cached.fileForId("application4.desktop"), built.fileForId("application4.desktop"));
+
+        /* A new file changes the modification time of its directory */
+        QString path = m_dataDirectories.at(1) + "/applications/wine/Programs/Application5/new.desktop";
+        writeDesktopFile(path, "new");
+        DesktopEntryIndex updated(m_dataDirectories, m_cacheFile);
+        QVERIFY(!updated.loadedFromCache());
+        QCOMPARE(updated.fileForId("wine-Programs-Application5-new.desktop"), path);
+        QFile::remove(path);
+    }
+
+    void benchmarkResolveFavorites_data()
+    {
+        QTest::addColumn<QString>("method");
+
+        QTest::newRow("gio") << "gio";
+        QTest::newRow("index built") << "index built";
+        QTest::newRow("index from cache") << "index from cache";
+    }
+
+    /* Resolving the favorites as the launcher does when it starts */
+    void benchmarkResolveFavorites()
+    {
+        QFETCH(QString, method);
+        QStringList ids = favoriteIds();
+
+        QBENCHMARK {
+            if (method == "gio") {
+                Q_FOREACH(const QString& id, ids) {
+                    GObjectScopedPointer<GDesktopAppInfo> appInfo(resolveWithGio(id));
+                    QVERIFY(appInfo);
+                }
+            } else {
+                if (method == "index built") {
+                    QFile::remove(m_cacheFile);
+                }
+                DesktopEntryIndex index(m_dataDirectories, m_cacheFile);
+                Q_FOREACH(const QString& id, ids) {
+                    GObjectScopedPointer<GDesktopAppInfo> appInfo(g_desktop_app_info_new_from_filename(
+                        QFile::encodeName(index.fileForId(id)).constData()));
+                    QVERIFY(appInfo);
+                }
+            }
+        }
+    }
+};
+
+QTEST_MAIN(DesktopEntryIndexTest)
+
+#include "desktopentryindextest.moc"
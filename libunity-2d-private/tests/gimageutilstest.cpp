@@ -0,0 +1,121 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <gimageutils.h>
+#include <gscopedpointer.h>
+
+// Qt
+#include <QImage>
+#include <QtTestGui>
+
+// GTK
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+static const int CHANNEL_ALPHA_PAIRS = 256 * 256;
+
+/* Pixbuf with alpha holding every (channel, alpha) pair, in the red, green
+   and blue channels with different values so that swapping them shows */
+static GdkPixbuf* createPixbuf(int width)
+{
+    int height = (CHANNEL_ALPHA_PAIRS + width - 1) / width;
+    GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, width, height);
+    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    guchar* pixels = gdk_pixbuf_get_pixels(pixbuf);
+    for (int y = 0; y < height; ++y) {
+        guchar* pixel = pixels + y * rowstride;
+        for (int x = 0; x < width; ++x, pixel += 4) {
+            int pair = (y * width + x) % CHANNEL_ALPHA_PAIRS;
+            int channel = pair % 256;
+            pixel[0] = channel;
+            pixel[1] = 255 - channel;
+            pixel[2] = channel ^ 0x55;
+            pixel[3] = pair / 256;
+        }
+    }
+    return pixbuf;
+}
+
+class GImageUtilsTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init()
+    {
+        g_type_init();
+    }
+
+    /* The SIMD path converts 4 pixels at a time and leaves the rest of the
+       line to the scalar path */
+    void testSimdMatchesScalar_data()
+    {
+        QTest::addColumn<int>("width");
+
+        QTest::newRow("1px") << 1;
+        QTest::newRow("3px") << 3;
+        QTest::newRow("4px") << 4;
+        QTest::newRow("5px") << 5;
+        QTest::newRow("6px") << 6;
+        QTest::newRow("7px") << 7;
+        QTest::newRow("256px") << 256;
+        QTest::newRow("257px") << 257;
+    }
+
+    void testSimdMatchesScalar()
+    {
+        QFETCH(int, width);
+        GObjectScopedPointer<GdkPixbuf> pixbuf(createPixbuf(width));
+
+        QImage simd = GImageUtils::imageForPixbuf(pixbuf.data(), true);
+        QImage scalar = GImageUtils::imageForPixbuf(pixbuf.data(), false);
+        QCOMPARE(simd.format(), QImage::Format_ARGB32_Premultiplied);
+        QCOMPARE(simd.size(), scalar.size());
+        for (int y = 0; y < simd.height(); ++y) {
+            const QRgb* simdLine = reinterpret_cast<const QRgb*>(simd.constScanLine(y));
+            const QRgb* scalarLine = reinterpret_cast<const QRgb*>(scalar.constScanLine(y));
+            for (int x = 0; x < simd.width(); ++x) {
+                if (simdLine[x] != scalarLine[x]) {
+                    QFAIL(qPrintable(QString("Pixel (%1, %2) differs: %3 instead of %4")
+                                     .arg(x).arg(y)
+                                     .arg(simdLine[x], 8, 16, QChar('0'))
+                                     .arg(scalarLine[x], 8, 16, QChar('0'))));
+                }
+            }
+        }
+    }
+
+    void testScalarPremultiplies()
+    {
+        GObjectScopedPointer<GdkPixbuf> pixbuf(createPixbuf(256));
+        QImage image = GImageUtils::imageForPixbuf(pixbuf.data(), false);
+        /* Row alpha holds every channel value with that alpha */
+        for (int alpha = 0; alpha < 256; ++alpha) {
+            for (int channel = 0; channel < 256; ++channel) {
+                QRgb pixel = image.pixel(channel, alpha);
+                QCOMPARE(qAlpha(pixel), alpha);
+                QVERIFY(qAbs(qRed(pixel) - channel * alpha / 255) <= 1);
+                QVERIFY(qAbs(qGreen(pixel) - (255 - channel) * alpha / 255) <= 1);
+                QVERIFY(qAbs(qBlue(pixel) - (channel ^ 0x55) * alpha / 255) <= 1);
+            }
+        }
+    }
+};
+
+QTEST_MAIN(GImageUtilsTest)
+
+#include "gimageutilstest.moc"
@@ -0,0 +1,147 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <iconutilities.h>
+
+// Qt
+#include <QColor>
+#include <QImage>
+#include <QtTestGui>
+
+/* Icon-like image: a colored gradient on a transparent background */
+static QImage createIcon(int size)
+{
+    QImage icon(size, size, QImage::Format_ARGB32);
+    icon.fill(0);
+    for (int y = size / 8; y < size - size / 8; y++) {
+        for (int x = size / 8; x < size - size / 8; x++) {
+            int alpha = 255 - (x * 128 / size);
+            icon.setPixel(x, y, qRgba(x * 255 / size, 200, y * 255 / size, alpha));
+        }
+    }
+    return icon;
+}
+
+/* The per pixel implementation IconUtilities used to have */
+static QColor referenceBaseColor(const QImage& icon)
+{
+    long int rtotal = 0, gtotal = 0, btotal = 0;
+    float total = 0.0f;
+
+    for (int y = 0; y < icon.height(); ++y) {
+        for (int x = 0; x < icon.width(); ++x) {
+            QColor color = QColor::fromRgba(icon.pixel(x, y));
+
+            float saturation = (qMax (color.red(), qMax (color.green(), color.blue())) -
+                                qMin (color.red(), qMin (color.green(), color.blue()))) / 255.0f;
+            float relevance = .1 + .9 * (color.alpha() / 255.0f) * saturation;
+
+            rtotal += (unsigned char) (color.red() * relevance);
+            gtotal += (unsigned char) (color.green() * relevance);
+            btotal += (unsigned char) (color.blue() * relevance);
+
+            total += relevance * 255;
+        }
+    }
+
+    return QColor::fromRgbF(rtotal / total, gtotal / total, btotal / total);
+}
+
+class IconUtilitiesTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testSimdMatchesScalar_data()
+    {
+        QTest::addColumn<int>("size");
+
+        QTest::newRow("48px") << 48;
+        QTest::newRow("50px") << 50;
+        QTest::newRow("128px") << 128;
+    }
+
+    void testSimdMatchesScalar()
+    {
+        QFETCH(int, size);
+        QImage icon = createIcon(size);
+
+        QList<QVariant> simd = IconUtilities::colorsFromImage(icon, true);
+        QList<QVariant> scalar = IconUtilities::colorsFromImage(icon, false);
+        QCOMPARE(simd.count(), 2);
+        QCOMPARE(simd.at(0).value<QColor>().rgba(), scalar.at(0).value<QColor>().rgba());
+        QCOMPARE(simd.at(1).value<QColor>().rgba(), scalar.at(1).value<QColor>().rgba());
+    }
+
+    void testMatchesReference()
+    {
+        QImage icon = createIcon(48);
+        QColor reference = referenceBaseColor(icon).toHsv();
+        QColor glow = IconUtilities::colorsFromImage(icon).at(1).value<QColor>().toHsv();
+        QVERIFY(qAbs(glow.hue() - reference.hue()) <= 1);
+    }
+
+    void benchmarkReference_data()
+    {
+        QTest::addColumn<int>("size");
+
+        QTest::newRow("48px") << 48;
+        QTest::newRow("128px") << 128;
+    }
+
+    void benchmarkReference()
+    {
+        QFETCH(int, size);
+        QImage icon = createIcon(size);
+        QBENCHMARK {
+            referenceBaseColor(icon);
+        }
+    }
+
+    void benchmarkScalar_data()
+    {
+        benchmarkReference_data();
+    }
+
+    void benchmarkScalar()
+    {
+        QFETCH(int, size);
+        QImage icon = createIcon(size);
+        QBENCHMARK {
+            IconUtilities::colorsFromImage(icon, false);
+        }
+    }
+
+    void benchmarkSimd_data()
+    {
+        benchmarkReference_data();
+    }
+
+    void benchmarkSimd()
+    {
+        QFETCH(int, size);
+        QImage icon = createIcon(size);
+        QBENCHMARK {
+            IconUtilities::colorsFromImage(icon, true);
+        }
+    }
+};
+
+QTEST_MAIN(IconUtilitiesTest)
+
+#include "iconutilitiestest.moc"
@@ -0,0 +1,189 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <spreadlayout.h>
+
+// Qt
+#include <QSet>
+#include <QTest>
+
+static QList<SpreadLayoutEngine::Item> createItems(int count)
+{
+    QList<SpreadLayoutEngine::Item> items;
+    for (int i = 0; i < count; i++) {
+        SpreadLayoutEngine::Item item;
+        item.id = i + 1;
+        /* Alternate landscape and portrait windows */
+        item.size = (i % 2 == 0) ? QSizeF(800, 600) : QSizeF(300, 700);
+        items.append(item);
+    }
+    return items;
+}
+
+class SpreadLayoutTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testGrid()
+    {
+        SpreadLayoutEngine engine;
+        engine.setGeometry(QSizeF(1000, 600), 10, 10);
+
+        engine.layout(createItems(10));
+        QCOMPARE(engine.columns(), 4);
+        QCOMPARE(engine.rows(), 3);
+
+        engine.layout(QList<SpreadLayoutEngine::Item>());
+        QCOMPARE(engine.columns(), 0);
+        QCOMPARE(engine.rows(), 0);
+    }
+
+    void testItemRects()
+    {
+        SpreadLayoutEngine engine;
+        engine.setGeometry(QSizeF(1000, 600), 10, 10);
+        QList<SpreadLayoutEngine::Item> items = createItems(7);
+        engine.layout(items);
+
+        QSet<int> cells;
+        Q_FOREACH(const SpreadLayoutEngine::Item& item, items) {
+            int cell = engine.cell(item.id);
+            QVERIFY(cell >= 0 && cell < engine.columns() * engine.rows());
+            QVERIFY(!cells.contains(cell));
+            cells.insert(cell);
+
+            QRectF rect = engine.itemRect(cell, item.size);
+            QVERIFY(engine.cellRect(cell).contains(rect));
+            QVERIFY(rect.width() <= item.size.width());
+            QVERIFY(qAbs(rect.width() / rect.height()
+                         - item.size.width() / item.size.height()) < 0.01);
+        }
+    }
+
+    void testSmallItemIsNotScaledUp()
+    {
+        SpreadLayoutEngine engine;
+        engine.setGeometry(QSizeF(1000, 600), 10, 10);
+        QCOMPARE(engine.itemRect(0, QSizeF(100, 50)), QRectF());
+
+        QList<SpreadLayoutEngine::Item> items = createItems(1);
+        items[0].size = QSizeF(100, 50);
+        engine.layout(items);
+        QCOMPARE(engine.itemRect(0, items[0].size), QRectF(450, 275, 100, 50));
+    }
+
+    void testNeighbourCells()
+    {
+        SpreadLayoutEngine engine;
+        engine.setGeometry(QSizeF(1000, 600), 10, 10);
+        /* 3x3 grid with the last cell empty */
+        engine.layout(createItems(8));
+
+        QCOMPARE(engine.item(4), quintptr(5));
+        QCOMPARE(engine.item(8), quintptr(0));
+        QCOMPARE(engine.neighbourCell(4, 1, 0), 5);
+        QCOMPARE(engine.neighbourCell(4, 0, -1), 1);
+        /* Navigation does not wrap, nor reach empty cells */
+        QCOMPARE(engine.neighbourCell(3, -1, 0), -1);
+        QCOMPARE(engine.neighbourCell(2, 1, 0), -1);
+        QCOMPARE(engine.neighbourCell(5, 0, 1), -1);
+        QCOMPARE(engine.neighbourCell(-1, 1, 0), -1);
+    }
+
+    void testRemovalKeepsOtherItemsInPlace()
+    {
+        SpreadLayoutEngine engine;
+        engine.setGeometry(QSizeF(1000, 600), 10, 10);
+        QList<SpreadLayoutEngine::Item> items = createItems(9);
+        engine.layout(items);
+
+        QHash<quintptr, int> before;
+        Q_FOREACH(const SpreadLayoutEngine::Item& item, items) {
+            before.insert(item.id, engine.cell(item.id));
+        }
+
+        /* 8 items still fit in a 3x3 grid */
+        items.removeAt(4);
+        QList<quintptr> changed = engine.layout(items);
+        QVERIFY(changed.isEmpty());
+        Q_FOREACH(const SpreadLayoutEngine::Item& item, items) {
+            QCOMPARE(engine.cell(item.id), before.value(item.id));
+        }
+
+        /* A new item takes the free cell */
+        SpreadLayoutEngine::Item item;
+        item.id = 100;
+        item.size = QSizeF(640, 480);
+        items.append(item);
+        changed = engine.layout(items);
+        QCOMPARE(changed, QList<quintptr>() << quintptr(100));
+        QCOMPARE(engine.cell(100), before.value(5));
+    }
+
+    void benchmarkLayout_data()
+    {
+        QTest::addColumn<int>("count");
+
+        QTest::newRow("10 windows") << 10;
+        QTest::newRow("100 windows") << 100;
+        QTest::newRow("500 windows") << 500;
+    }
+
+    void benchmarkLayout()
+    {
+        QFETCH(int, count);
+        QList<SpreadLayoutEngine::Item> items = createItems(count);
+
+        QBENCHMARK {
+            SpreadLayoutEngine engine;
+            engine.setGeometry(QSizeF(1920, 1080), 10, 20);
+            engine.layout(items);
+            Q_FOREACH(const SpreadLayoutEngine::Item& item, items) {
+                engine.itemRect(engine.cell(item.id), item.size);
+            }
+        }
+    }
+
+    void benchmarkIncrementalLayout_data()
+    {
+        benchmarkLayout_data();
+    }
+
+    /* One window closed and another opened, as happens while the spread
+       is shown */
+    void benchmarkIncrementalLayout()
+    {
+        QFETCH(int, count);
+        QList<SpreadLayoutEngine::Item> items = createItems(count);
+        SpreadLayoutEngine engine;
+        engine.setGeometry(QSizeF(1920, 1080), 10, 20);
+        engine.layout(items);
+
+        QBENCHMARK {
+            SpreadLayoutEngine::Item item = items.takeAt(count / 2);
+            engine.layout(items);
+            items.append(item);
+            engine.layout(items);
+        }
+    }
+};
+
+QTEST_MAIN(SpreadLayoutTest)
+
+#include "spreadlayouttest.moc"
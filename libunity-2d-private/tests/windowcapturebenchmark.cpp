@@ -0,0 +1,136 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares capturing windows synchronously on the GUI thread with capturing
+ * them through WindowCapturePipeline.
+ *
+ * Usage: windowcapturebenchmark [window count] [thumbnail width]
+ *
+ * It creates the windows itself, so it can run headless, for example with:
+ *   xvfb-run -s "-screen 0 1920x1080x24" ./windowcapturebenchmark 40 300
+ */
+
+// Local
+#include <unity2dapplication.h>
+#include <windowcapturepipeline.h>
+#include <windowgrabber.h>
+#include <windowimageprovider.h>
+
+// Qt
+#include <QElapsedTimer>
+#include <QImage>
+#include <QSignalSpy>
+#include <QWidget>
+#include <QX11Info>
+
+// X11
+#include <X11/Xlib.h>
+
+// System
+#include <stdio.h>
+#include <unistd.h>
+
+static const QSize WINDOW_SIZE(800, 600);
+
+static void waitForWindows()
+{
+    XSync(QX11Info::display(), False);
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 500) {
+        QApplication::processEvents();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Unity2dApplication::earlySetup(argc, argv);
+    Unity2dApplication app(argc, argv);
+
+    int count = (argc > 1) ? QString(argv[1]).toInt() : 40;
+    int thumbnailWidth = (argc > 2) ? QString(argv[2]).toInt() : 0;
+    QSize requestedSize;
+    if (thumbnailWidth > 0) {
+        requestedSize = QSize(thumbnailWidth,
+                              thumbnailWidth * WINDOW_SIZE.height() / WINDOW_SIZE.width());
+    }
+
+    WindowImageProvider::activateComposite();
+
+    QList<QWidget*> windows;
+    for (int i = 0; i < count; i++) {
+        QWidget* window = new QWidget;
+        QPalette palette = window->palette();
+        palette.setColor(QPalette::Window, QColor::fromHsv((i * 37) % 360, 200, 200));
+        window->setPalette(palette);
+        window->setAutoFillBackground(true);
+        window->resize(WINDOW_SIZE);
+        window->move((i * 20) % 400, (i * 20) % 300);
+        window->show();
+        windows.append(window);
+    }
+    waitForWindows();
+
+    QElapsedTimer timer;
+
+    /* Synchronous: everything happens on the GUI thread */
+    WindowGrabber grabber(QX11Info::display());
+    int captured = 0;
+    timer.start();
+    Q_FOREACH(QWidget* window, windows) {
+        if (!grabber.grab(window->winId(), requestedSize, true).isNull()) {
+            captured++;
+        }
+    }
+    qint64 synchronousTime = timer.elapsed();
+    printf("synchronous:  %d/%d thumbnails in %lld ms, GUI thread blocked %lld ms\n",
+           captured, count, synchronousTime, synchronousTime);
+
+    /* Asynchronous: the GUI thread only queues captures and receives results */
+    WindowCapturePipeline pipeline;
+    QSignalSpy spy(&pipeline, SIGNAL(captured(unsigned int, const QImage&)));
+    qint64 blockedTime = 0;
+    timer.start();
+    Q_FOREACH(QWidget* window, windows) {
+        pipeline.capture(window->winId(), requestedSize, 0, true);
+    }
+    blockedTime += timer.elapsed();
+    /* Poll instead of waiting for events so that the time spent sleeping
+       is not accounted as blocked */
+    while (spy.count() < count) {
+        QElapsedTimer eventTimer;
+        eventTimer.start();
+        app.processEvents();
+        blockedTime += eventTimer.elapsed();
+        usleep(1000);
+    }
+    qint64 asynchronousTime = timer.elapsed();
+
+    captured = 0;
+    for (int i = 0; i < spy.count(); i++) {
+        if (!spy.at(i).at(1).value<QImage>().isNull()) {
+            captured++;
+        }
+    }
+    printf("asynchronous: %d/%d thumbnails in %lld ms, GUI thread blocked %lld ms (%d workers)\n",
+           captured, count, asynchronousTime, blockedTime, pipeline.workerCount());
+
+    qDeleteAll(windows);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Local
+#include <windowimageprovider.h>
+
+// Qt
+#include <QPixmap>
+#include <QRegion>
+#include <QtTestGui>
+
+static const QSize PIXMAP_SIZE(200, 100);
+
+/* Stands for the X server: counts the reads instead of doing them */
+static int sReadCount = 0;
+
+static QImage fakeReadPixmap(const QPixmap& pixmap)
+{
+    sReadCount++;
+    QImage image(pixmap.size(), QImage::Format_RGB32);
+    image.fill(QColor(Qt::red).rgb());
+    return image;
+}
+
+/* A comb made of count vertical teeth, one pixel apart */
+static QRegion combShape(int count)
+{
+    QRegion shape;
+    for (int i = 0; i < count; i++) {
+        shape += QRect(i * 2, 0, 1, PIXMAP_SIZE.height());
+    }
+    return shape;
+}
+
+class WindowImageProviderTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testPixmapIsReadOnce_data()
+    {
+        QTest::addColumn<int>("rectangleCount");
+
+        QTest::newRow("1 rectangle") << 1;
+        QTest::newRow("10 rectangles") << 10;
+        QTest::newRow("50 rectangles") << 50;
+    }
+
+    void testPixmapIsReadOnce()
+    {
+        QFETCH(int, rectangleCount);
+
+        QPixmap pixmap(PIXMAP_SIZE);
+        QRegion shape = combShape(rectangleCount);
+        QCOMPARE(shape.rects().count(), rectangleCount);
+
+        sReadCount = 0;
+        QImage image = WindowImageProvider::convertWindowPixmap(pixmap, shape, fakeReadPixmap);
+        QCOMPARE(sReadCount, 1);
+
+        QCOMPARE(image.size(), PIXMAP_SIZE);
+        QCOMPARE(QColor::fromRgba(image.pixel(0, 0)), QColor(Qt::red));
+        QCOMPARE(qAlpha(image.pixel(1, 0)), 0);
+        QCOMPARE(qAlpha(image.pixel(PIXMAP_SIZE.width() - 1, 0)), 0);
+    }
+
+    void testEmptyShapeMeansUnshaped()
+    {
+        QPixmap pixmap(PIXMAP_SIZE);
+
+        sReadCount = 0;
+        QImage image = WindowImageProvider::convertWindowPixmap(pixmap, QRegion(), fakeReadPixmap);
+        QCOMPARE(sReadCount, 1);
+
+        QCOMPARE(image.size(), PIXMAP_SIZE);
+        QCOMPARE(QColor::fromRgba(image.pixel(0, 0)), QColor(Qt::red));
+        QCOMPARE(QColor::fromRgba(image.pixel(PIXMAP_SIZE.width() - 1, 0)), QColor(Qt::red));
+    }
+};
+
+QTEST_MAIN(WindowImageProviderTest)
+
+#include "windowimageprovidertest.moc"
@@ -0,0 +1,81 @@
+/*
+ * This file is part of unity-2d
+ *
+ * Copyright 2011 Canonical Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Fills the icon cache shared by the unity-2d processes (see IconDiskCache)
+   with all the icons of the current theme, so that they do not have to be
+   decoded at startup or when the dash is first opened.
+
+   Usage: unity-2d-icon-cache [--size N]...
+   The default sizes are the ones used by the launcher, the dash and the
+   panel. */
+
+// GTK
+#include <gtk/gtk.h>
+
+// Local
+#include <icondiskcache.h>
+
+// Qt
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+#include <QTextStream>
+
+int main(int argc, char** argv)
+{
+    gtk_init(&argc, &argv);
+    QCoreApplication app(argc, argv);
+
+    QList<int> sizes;
+    QStringList arguments = app.arguments();
+    for (int i = 1; i < arguments.count(); i++) {
+        if (arguments.at(i) == "--size" && i + 1 < arguments.count()) {
+            sizes << arguments.at(++i).toInt();
+        } else {
+            QTextStream(stderr) << "Usage: " << arguments.at(0) << " [--size N]...\n";
+            return 1;
+        }
+    }
+    if (sizes.isEmpty()) {
+        sizes << 22 << 24 << 32 << 48 << 64 << 128;
+    }
+
+    IconDiskCache* cache = IconDiskCache::instance();
+    QTextStream out(stdout);
+    out << "Caching icons in " << cache->themeDirectory(QString()) << "\n";
+
+    QElapsedTimer timer;
+    timer.start();
+    int count = 0;
+    GList* icons = gtk_icon_theme_list_icons(gtk_icon_theme_get_default(), NULL);
+    for (GList* icon = icons; icon != NULL; icon = g_list_next(icon)) {
+        QString name = QString::fromUtf8(static_cast<const char*>(icon->data));
+        Q_FOREACH(int size, sizes) {
+            if (!cache->imageForIconString(name, size).isNull()) {
+                count++;
+            }
+        }
+        g_free(icon->data);
+    }
+    g_list_free(icons);
+
+    out << count << " icons cached (" << cache->hitCount() << " already were) in "
+        << timer.elapsed() << " ms\n";
+    return 0;
+}
@@ -18,7 +18,6 @@
 
 import QtQuick 1.1
 import Unity2d 1.0
-import Effects 1.0
 
 Item {
     id: dash
@@ -144,6 +143,8 @@ Item {
         effect: CacheEffect {}
 
         Item {
+            id: backgroundArea
+
             anchors.fill: parent
             anchors.bottomMargin: content.anchors.bottomMargin
             anchors.rightMargin: content.anchors.rightMargin
@@ -152,8 +153,6 @@ Item {
             Image {
                 id: blurredBackground
 
-                effect: Blur {blurRadius: 12}
-
                 /* 'source' needs to be set when the dash becomes visible, that
                    is when declarativeView.active becomes true, so that a
                    screenshot of the windows behind the dash is taken at that
@@ -171,13 +170,19 @@ Item {
                     onActiveChanged: blurredBackground.timeAtActivation = screen.currentTime()
                 }
 
-                /* Use an image of the root window which essentially is a
-                   capture of the entire screen */
-                source: declarativeView.active ? "image://window/root@" + blurredBackground.timeAtActivation : ""
+                /* Only the area of the screen covered by the dash is captured,
+                   downscaled and blurred by the image provider outside of the
+                   GUI thread. The small image it returns is scaled back up. */
+                source: declarativeView.active ? "image://blurredbackground/"
+                                                 + declarativeView.globalPosition.x + ","
+                                                 + declarativeView.globalPosition.y + ","
+                                                 + backgroundArea.width + "x" + backgroundArea.height
+                                                 + "@" + blurredBackground.timeAtActivation : ""
+                asynchronous: true
+                smooth: true
 
-                fillMode: Image.PreserveAspectCrop
-                x: -declarativeView.globalPosition.x
-                y: -declarativeView.globalPosition.y
+                anchors.fill: parent
+                fillMode: Image.Stretch
             }
 
             Image {
@@ -73,36 +73,31 @@ Item {
         visible: window.isSelected
     }
 
-    /* Screenshot of the window, minus the decorations. The actual image is
-       obtained via the WindowImageProvider which serves the "image://window/*" source URIs.
-       Please note that the screenshot is taken at the moment the source property is
-       actually assigned, during component initialization.
+    /* Screenshot of the window, minus the decorations. The image is
+       shared with the other views of the same window, for example the
+       workspaces showing a window pinned to all of them, so that it's
+       captured and stored only once (see WindowThumbnailRegistry).
+       It is captured again only when the window contents changed, and only
+       while the spread is shown so that hidden windows are not captured for
+       nothing.
        If taking the screenshot fails (for example for minimized windows), then this
-       is hidden and the icon box (see "icon_box" below) is shown. */
-    Image {
+       is hidden and the icon box (see "icon_box" below) is shown. The same happens
+       while the first screenshot of the window is captured in the background. */
+    WindowThumbnail {
         id: shot
 
         anchors.fill: parent
 		anchors.margins: 5
 		anchors.bottomMargin: 35
-        fillMode: Image.Stretch
-
-        /* HACK: QML uses an internal cache for Image objects that seems to use as
-           key the source property of the image.
-           This is great for normal images but in this case we really want the
-           screenshot to reload everytime.
-           Since I could not find any way to disable this cache, I am using this
-           hack which essentially appends the current time to the source URL of the
-           Image, tricking the cache into doing a request to the image provider.
-        */
-        source: "image://window/" + windowInfo.decoratedXid + "|"
-                                  + windowInfo.contentXid + "@"
-                                  + screen.currentTime()
+
+        windowId: windowInfo.decoratedXid
+        contentId: windowInfo.contentXid
+        live: switcher.shown
 
         /* Disabled during animations for performance reasons */
         smooth: !animating
 
-        visible: (status != Image.Error)
+        visible: valid
     }
 
     /* This replaces the shot whenever retrieving its image fails.
@@ -122,7 +117,7 @@ Item {
 		radius: 10
 
 
-        visible: (shot.status == Image.Error)
+        visible: !shot.valid
 
         Image {
             source: "image://icons/" + windowInfo.icon
@@ -165,8 +160,8 @@ Item {
     MouseArea {
         id: mouseArea
 
-        width: shot.paintedWidth
-        height: shot.paintedHeight
+        width: shot.width
+        height: shot.height
         anchors.centerIn: parent
         hoverEnabled: true
 
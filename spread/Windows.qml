@@ -26,8 +26,8 @@ import "utils.js" as Utils
 import Unity2d 1.0
 
 /* The main component that manages the windows.
-   This only acts as an outer shell, the actual logic is pretty much all in SpreadLayout.qml
-   and SpreadItem.qml
+   This only acts as an outer shell, the geometry of the windows in the spread is
+   computed by SpreadLayout and the rest of the logic is in Window.qml
 
    In the rest of the comments there will be some recurring terms that I explain below:
    - screen mode: in this mode each shot is positioned and scaled exactly as the real window.
@@ -55,51 +55,44 @@ GridView {
         hoverEnabled: true
     }
 
-    /* This proxy model takes care of removing all windows that are not on
-       the current workspace and that are not pinned to all workspaces. */
-    SortFilterProxyModel {
-        id: filteredByWorkspace
-        model: switcher.allWindows
-        dynamicSortFilter: true
-
-        filterRole: WindowInfo.RoleWorkspace
-        //filterRegExp: RegExp("^%1|-2$".arg(workspace.workspaceNumber))
+    /* Windows of the application the spread is filtered on, if any.
+       They are looked up in the indexes of the list of all windows, so
+       changing the filter does not touch the windows of other applications. */
+    FilteredWindowsList {
+        id: filteredWindows
+        windows: switcher.allWindows
+        applicationFilter: switcher.applicationFilter
     }
 
-    /* If there's any application filter set, this proxy model will remove
-       all windows that do not belong to it. */
-    SortFilterProxyModel {
-        id: filteredByApplication
-        model: filteredByWorkspace
-        dynamicSortFilter: true
-
-        filterRole: WindowInfo.RoleDesktopFile
-        filterRegExp: RegExp("%1".arg(switcher.applicationFilter))
-    }
-
-    property int columns: Math.ceil(Math.sqrt(count))
-    property int rows: Math.ceil(count / columns)
     property int cellSpacingVertical: 10
     property int cellSpacingHorizontal: 20
+    /* Room left under the cells of every row for the title of the windows */
+    property int labelHeight: 20
+
+    /* Computes in C++, in one pass, the cell of every window and the
+       geometry of its shot, exposed as the cellRect and thumbnailRect roles.
+       Windows keep their cell when others are opened or closed. */
+    SpreadLayout {
+        id: layout
+        model: filteredWindows
+        width: windows.width
+        height: windows.height - rows * labelHeight
+        horizontalSpacing: cellSpacingHorizontal
+        verticalSpacing: cellSpacingVertical
+    }
+
+    property int columns: Math.max(1, layout.columns)
+    property int rows: Math.max(1, layout.rows)
 
     cellWidth: Math.floor(width / columns)
-    cellHeight: height / rows - 20
+    cellHeight: height / rows - labelHeight
 
-    model: filteredByApplication
+    model: layout
 
     delegate:
         Item {
             id: cell
 
-            ScaledItem {
-                id: scaledCell
-
-                target: cell
-                itemWidth: window.size.width
-                itemHeight: window.size.height
-                parent: windows
-            }
-
             /* Workaround http://bugreports.qt.nokia.com/browse/QTBUG-15642 where onAdd is not called for the first item */
             //GridView.onAdd:
             Component.onCompleted: if (!switcher.initial) addAnimation.start()
@@ -114,6 +107,34 @@ GridView {
                     case Qt.Key_Return:
                         windows.windowActivated(spreadWindow)
                         event.accepted = true
+                        break
+                    /* Windows are not shown in the order of the rows of the
+                       model, so move to the window in the neighbouring cell
+                       instead of letting GridView pick the next row */
+                    case Qt.Key_Left:
+                        selectNeighbour(-1, 0)
+                        event.accepted = true
+                        break
+                    case Qt.Key_Right:
+                        selectNeighbour(1, 0)
+                        event.accepted = true
+                        break
+                    case Qt.Key_Up:
+                        selectNeighbour(0, -1)
+                        event.accepted = true
+                        break
+                    case Qt.Key_Down:
+                        selectNeighbour(0, 1)
+                        event.accepted = true
+                        break
+                }
+            }
+
+            function selectNeighbour(columnStep, rowStep) {
+                var neighbour = layout.neighbourRow(index, columnStep, rowStep)
+                if (neighbour != -1) {
+                    windows.currentIndex = neighbour
+                    windows.currentItem.forceActiveFocus()
                 }
             }
 
@@ -162,11 +183,11 @@ GridView {
                         name: "spread"
                         PropertyChanges {
                             target: spreadWindow
-                            /* Center the window in its cell */
-                            x: followCell ? scaledCell.x + cellSpacingVertical : x
-                            y: followCell ? scaledCell.y + cellSpacingHorizontal : y
-                            width: followCell ? scaledCell.width - cellSpacingVertical * 2 : width
-                            height: followCell ? scaledCell.height - cellSpacingHorizontal * 2: height
+                            /* Centered in its cell by SpreadLayout */
+                            x: followCell ? thumbnailRect.x : x
+                            y: followCell ? thumbnailRect.y : y
+                            width: followCell ? thumbnailRect.width : width
+                            height: followCell ? thumbnailRect.height : height
                             animateFollow: !switcher.initial
                         }
                     }
@@ -24,19 +24,27 @@
 import QtQuick 1.1
 import Unity2d 1.0
 import "utils.js" as Utils
-import Effects 1.0
 
 Rectangle {
     id: switcher
 
     //color: "black"
 
-    property string applicationFilter
+    /* Set by the D-Bus methods of the spread before the signals below are
+       emitted */
+    property string applicationFilter: control.applicationFilter
     property int zoomedWorkspace: 0
 
-    property variant allWindows: WindowsList { }
+    /* The list of windows is loaded once at startup then kept up to date
+       while the spread is hidden, so that showing it is immediate */
+    property variant allWindows: WindowsList { resident: true }
     property int lastActiveWindow: 0
 
+    /* Thumbnails are only refreshed while shown, see Window.qml */
+    property bool shown: false
+
+    Component.onCompleted: allWindows.load()
+
     Repeater {
         id: workspaces
 
@@ -53,14 +61,8 @@ Rectangle {
     Image {
         id: blurredBackground
 
-        effect: Blur {blurRadius: 12}
-
-        /* 'source' needs to be set when the dash becomes visible, that
-           is when declarativeView.active becomes true, so that a
-           screenshot of the windows behind the dash is taken at that
-           point.
-           'source' also needs to change so that the screenshot is
-           re-taken as opposed to pulled from QML's image cache.
+        /* 'source' needs to change so that the screenshot is re-taken as
+           opposed to pulled from QML's image cache.
            This workarounds the fact that the image cache cannot be
            disabled. A new API to deal with this was introduced in Qt Quick 1.1.
 
@@ -68,13 +70,19 @@ Rectangle {
         */
         property variant timeAtActivation
 
-        /* Use an image of the root window which essentially is a
-           capture of the entire screen */
-        source: "image://window/root@" + blurredBackground.timeAtActivation
+        /* Only the area of the screen covered by the spread is captured,
+           downscaled and blurred by the image provider outside of the GUI
+           thread. The small image it returns is scaled back up. */
+        source: "image://blurredbackground/"
+                + declarativeView.globalPosition.x + ","
+                + declarativeView.globalPosition.y + ","
+                + switcher.width + "x" + switcher.height
+                + "@" + blurredBackground.timeAtActivation
+        asynchronous: true
+        smooth: true
 
-        fillMode: Image.PreserveAspectCrop
-        x: -declarativeView.globalPosition.x
-        y: -declarativeView.globalPosition.y
+        anchors.fill: parent
+        fillMode: Image.Stretch
     }
     Image {
         anchors.fill: parent
@@ -87,19 +95,16 @@ Rectangle {
         target: control
 
         onShowCurrentWorkspace: {
-            applicationFilter = applicationDesktopFile
             zoomedWorkspace = 0
             show()
         }
 
         onShowAllWorkspaces: {
-            applicationFilter = applicationDesktopFile
             zoomedWorkspace = 0
             show()
         }
 
         onHide: cancelAndExit()
-        onFilterByApplication: applicationFilter = applicationDesktopFile
     }
 
     function show() {
@@ -108,6 +113,7 @@ Rectangle {
 
         allWindows.load()
 
+        shown = true
         spreadView.show()
         spreadView.forceActivateWindow()
         //switcher.forceActiveFocus()
@@ -135,6 +141,7 @@ Rectangle {
     }
 
     function cancelAndExit() {
+        shown = false
         spreadView.hide()
         //allWindows.unload() //caused segfault :(
         zoomedWorkspace = 0
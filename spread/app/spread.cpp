@@ -66,6 +66,7 @@ int main(int argc, char *argv[])
     SpreadControl control;
     control.connectToBus();
     control.connect(&view, SIGNAL(visibleChanged(bool)), SLOT(setIsShown(bool)));
+    control.connect(&view, SIGNAL(firstFramePainted()), SLOT(endActivation()));
     view.rootContext()->setContextProperty("control", &control);
 
     /* Load the QML UI, focus and show the window */
@@ -24,12 +24,15 @@
 #include "spreadadaptor.h"
 #include "launcherclient.h"
 
+#include <debug_p.h>
+
 static const char* DBUS_SERVICE = "com.canonical.Unity2d.Spread";
 static const char* DBUS_OBJECT_PATH = "/Spread";
 
 SpreadControl::SpreadControl(QObject *parent) :
     QObject(parent), m_isShown(false),
-    m_launcherClient(new LauncherClient(this))
+    m_launcherClient(new LauncherClient(this)),
+    m_activationLatency(-1)
 {
 }
 
@@ -61,21 +64,53 @@ bool SpreadControl::connectToBus()
     return true;
 }
 
+/* The activation latency is the time between a request to show the spread
+   and the first frame painted on screen. Requests made while the spread is
+   already shown are not measured since nothing new gets painted. */
+void SpreadControl::beginActivation()
+{
+    if (!m_isShown) {
+        m_activationTimer.start();
+    }
+}
+
+void SpreadControl::endActivation()
+{
+    if (m_activationTimer.isValid()) {
+        m_activationLatency = m_activationTimer.elapsed();
+        m_activationTimer.invalidate();
+        UQ_DEBUG << "Spread activation took" << m_activationLatency << "ms";
+    }
+}
+
 void SpreadControl::ShowAllWorkspaces(QString applicationDesktopFile)
 {
+    beginActivation();
+    setApplicationFilter(applicationDesktopFile);
     Q_EMIT showAllWorkspaces(applicationDesktopFile);
 }
 
 void SpreadControl::ShowCurrentWorkspace(QString applicationDesktopFile)
 {
+    beginActivation();
+    setApplicationFilter(applicationDesktopFile);
     Q_EMIT showCurrentWorkspace(applicationDesktopFile);
 }
 
 void SpreadControl::FilterByApplication(QString applicationDesktopFile)
 {
+    setApplicationFilter(applicationDesktopFile);
     Q_EMIT filterByApplication(applicationDesktopFile);
 }
 
+void SpreadControl::setApplicationFilter(const QString &applicationFilter)
+{
+    if (applicationFilter != m_applicationFilter) {
+        m_applicationFilter = applicationFilter;
+        Q_EMIT applicationFilterChanged(applicationFilter);
+    }
+}
+
 void SpreadControl::Hide()
 {
     Q_EMIT hide();
@@ -23,6 +23,7 @@
 
 #include <QObject>
 #include <QDBusContext>
+#include <QElapsedTimer>
 #include <QtDeclarative/qdeclarative.h>
 #include <QWidget>
 
@@ -32,31 +33,46 @@ class SpreadControl : public QObject, protected QDBusContext
 {
     Q_OBJECT
 
+    /* Desktop file of the application whose windows are spread, or an
+       empty string for all windows */
+    Q_PROPERTY(QString applicationFilter READ applicationFilter NOTIFY applicationFilterChanged)
+
 public:
     explicit SpreadControl(QObject *parent = 0);
     ~SpreadControl();
 
     bool connectToBus();
 
+    QString applicationFilter() const { return m_applicationFilter; }
+
 public Q_SLOTS:
     Q_NOREPLY void ShowAllWorkspaces(QString applicationDesktopFile);
     Q_NOREPLY void ShowCurrentWorkspace(QString applicationDesktopFile);
     Q_NOREPLY void FilterByApplication(QString applicationDesktopFile);
     Q_NOREPLY void Hide();
     bool IsShown() { return m_isShown; }
+    int ActivationLatency() { return m_activationLatency; }
 
 private Q_SLOTS:
     void setIsShown(bool isShown);
+    void endActivation();
 
 Q_SIGNALS:
     void showAllWorkspaces(QString applicationDesktopFile);
     void showCurrentWorkspace(QString applicationDesktopFile);
     void filterByApplication(QString applicationDesktopFile);
     void hide();
+    void applicationFilterChanged(const QString &applicationFilter);
 
 private:
+    void beginActivation();
+    void setApplicationFilter(const QString &applicationFilter);
+
     bool m_isShown;
     LauncherClient *m_launcherClient;
+    QElapsedTimer m_activationTimer;
+    int m_activationLatency;
+    QString m_applicationFilter;
 };
 
 QML_DECLARE_TYPE(SpreadControl)
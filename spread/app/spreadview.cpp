@@ -45,7 +45,7 @@ extern "C" {
 #include <libwnck/libwnck.h>
 }
 
-SpreadView::SpreadView() : Unity2DDeclarativeView()
+SpreadView::SpreadView() : Unity2DDeclarativeView(), m_firstFramePending(false)
 {
 }
 
@@ -148,11 +148,22 @@ void SpreadView::showEvent(QShowEvent *event)
 {
     fitToAvailableSpace(); //always adjust size
     Q_UNUSED(event);
+    m_firstFramePending = true;
     Q_EMIT visibleChanged(true);
 }
 
 void SpreadView::hideEvent(QHideEvent *event)
 {
     Q_UNUSED(event);
+    m_firstFramePending = false;
     Q_EMIT visibleChanged(false);
 }
+
+void SpreadView::paintEvent(QPaintEvent *event)
+{
+    Unity2DDeclarativeView::paintEvent(event);
+    if (m_firstFramePending) {
+        m_firstFramePending = false;
+        Q_EMIT firstFramePainted();
+    }
+}
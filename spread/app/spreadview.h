@@ -40,11 +40,17 @@ protected:
     virtual void focusOutEvent( QFocusEvent * event );
     virtual void showEvent(QShowEvent *event);
     virtual void hideEvent(QHideEvent *event);
+    virtual void paintEvent(QPaintEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
 
 Q_SIGNALS:
     void outsideClick();
     void visibleChanged(bool visible);
+    /* Emitted once the first frame after the view got shown is painted */
+    void firstFramePainted();
+
+private:
+    bool m_firstFramePending;
 };
 
 #endif // SPREADVIEW_H